@@ -0,0 +1,201 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2023 David Caadas Mazo.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE.
+ */
+
+// Compares block-compressed files (see dlog_block_file.h) with plain text files written by dlog::FileBackend:
+// time spent by the logging thread, file size and query time. Plain text is queried the way grep would, a line at
+// a time; block files are queried through BlockFileReader, which skips the blocks that can't match.
+// Messages look like those of a web service: mostly INF, a few WRN and ERR, and a rare "audit" category logged
+// in bursts.
+//
+// Usage: block_file_bench [messages] [output directory]
+
+#include "../dlog_block_file.h"
+#include "../dlog_file_backend.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+namespace
+{
+struct Span
+{
+    int64_t fromTimestamp = INT64_MAX;
+    int64_t toTimestamp   = INT64_MIN;
+};
+
+// Logs in_messageCount messages and returns the range of their timestamps.
+template<typename TSETUP>
+Span Write(const size_t in_messageCount, TSETUP in_setup, double& out_nanosecondsPerMessage)
+{
+    static const char* const k_paths[] = { "/api/items", "/api/users", "/api/orders", "/static/app.js", "/health" };
+    static const char* const k_methods[] = { "GET", "GET", "GET", "POST", "PUT" };
+    Span span;
+    DLog logger;
+    logger.prefixFormatter = dlog::TimestampFormatter(3, true);
+    in_setup(logger);
+
+    uint32_t random = 12345;
+    const auto next = [&random]() { random = (random * 1103515245u) + 12345u; return random >> 8; };
+    const auto start = std::chrono::steady_clock::now();
+    span.fromTimestamp = dlog::Now();
+    for (size_t i = 0; i < in_messageCount; ++i)
+    {
+        const uint32_t value = next();
+        if ((i % 50000) < 20)
+            DLOG(DINFO, "audit") << "[audit] user=u" << (value % 1000) << " action=login source=10.0." << (value % 256) << '.' << (i % 256);
+        else if ((value % 5000) == 0)
+            DLOG(DERROR, "db") << "[db] query failed table=orders id=" << i << " error=\"deadlock detected\" retry=" << (value % 3);
+        else if ((value % 500) == 0)
+            DLOG(DWARNING, "http") << "[http] slow request method=" << k_methods[value % 5] << " path=" << k_paths[(value >> 3) % 5] << '/' << (value % 10000) << " took=" << (value % 3000) << "ms";
+        else
+            DLOG(DINFO, "http") << "[http] request method=" << k_methods[value % 5] << " path=" << k_paths[(value >> 3) % 5] << '/' << (value % 10000) << " status=200 took=" << (value % 40) << '.' << (value % 10) << "ms";
+    }
+    span.toTimestamp = dlog::Now();
+    out_nanosecondsPerMessage = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / double(in_messageCount);
+    return span;
+}
+
+long long GetFileSize(const std::string& in_fileName)
+{
+#if defined(_MSC_VER)
+#   pragma warning(suppress: 4996) // This function or variable may be unsafe. Consider using fopen_s instead.
+#endif//defined(_MSC_VER)
+    FILE* file = fopen(in_fileName.c_str(), "rb");
+    if (!file)
+        return 0;
+    fseek(file, 0, SEEK_END);
+    const long long size = ftell(file);
+    fclose(file);
+    return size;
+}
+
+// "YYYY-MM-DD HH:MM:SS.mmm", as TimestampFormatter(3, true) writes it, so that lines compare lexicographically.
+std::string FormatTimestamp(const int64_t in_timestamp)
+{
+    const std::time_t seconds = std::time_t(in_timestamp / 1000000000);
+    char text[32] = "";
+#if defined(_MSC_VER)
+#   pragma warning(suppress: 4996) // This function or variable may be unsafe. Consider using gmtime_s instead.
+#endif//defined(_MSC_VER)
+    if (const std::tm* utc = std::gmtime(&seconds))
+        std::strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", utc);
+    snprintf(text + strlen(text), sizeof(text) - strlen(text), ".%03d", int((in_timestamp / 1000000) % 1000));
+    return text;
+}
+
+// Counts the lines of a text file that in_match accepts.
+template<typename TMATCH>
+size_t ScanText(const std::string& in_fileName, TMATCH in_match)
+{
+#if defined(_MSC_VER)
+#   pragma warning(suppress: 4996) // This function or variable may be unsafe. Consider using fopen_s instead.
+#endif//defined(_MSC_VER)
+    FILE* file = fopen(in_fileName.c_str(), "rb");
+    if (!file)
+        return 0;
+    size_t count = 0;
+    char line[4096];
+    while (fgets(line, sizeof(line), file))
+        count += in_match(line) ? 1 : 0;
+    fclose(file);
+    return count;
+}
+
+size_t QueryBlocks(const std::string& in_fileName, const dlog::BlockQuery& in_query, dlog::BlockFileReader::Statistics& out_statistics)
+{
+    dlog::BlockFileReader reader(in_fileName.c_str(), in_query);
+    dlog::BlockFileReader::Record record;
+    size_t count = 0;
+    while (reader.ReadNext(record))
+        ++count;
+    out_statistics = reader.GetStatistics();
+    return count;
+}
+
+template<typename TFUNC>
+double Measure(TFUNC in_function, size_t& out_count)
+{
+    const auto start = std::chrono::steady_clock::now();
+    out_count = in_function();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+template<typename TMATCH>
+void Compare(const char* in_name, const std::string& in_textFileName, TMATCH in_match, const std::string& in_blockFileName, const dlog::BlockQuery& in_query)
+{
+    size_t textCount = 0, blockCount = 0;
+    dlog::BlockFileReader::Statistics statistics;
+    const double textTime  = Measure([&]() { return ScanText(in_textFileName, in_match); }, textCount);
+    const double blockTime = Measure([&]() { return QueryBlocks(in_blockFileName, in_query, statistics); }, blockCount);
+    printf("%-16s text %8.1f ms (%7zu)   blocks %8.1f ms (%7zu, %llu of %llu blocks skipped)\n", in_name, textTime, textCount, blockTime, blockCount,
+           (unsigned long long)statistics.skippedBlocks, (unsigned long long)statistics.blocks);
+}
+}
+
+int main(int argc, char** argv)
+{
+    const size_t messageCount = (argc > 1) ? (size_t)std::atoi(argv[1]) : 2000000;
+    const std::string directory = (argc > 2) ? argv[2] : ".";
+    printf("%zu message(s), %u hardware thread(s).\n", messageCount, std::thread::hardware_concurrency()); // With one, compression is not off the logging thread.
+
+    dlog::FileOptions textOptions;
+    textOptions.fileName = directory + "/bench_plain.log";
+    double textWrite = 0.0;
+    const Span textSpan = Write(messageCount, [&](DLog& inout_logger) { inout_logger += DLog::BatchBackend { dlog::FileBackend(textOptions), { } }; }, textWrite);
+
+    dlog::BlockFileOptions blockOptions;
+    blockOptions.fileName = directory + "/bench_blocks.dlb";
+    double blockWrite = 0.0;
+    const Span blockSpan = Write(messageCount, [&](DLog& inout_logger) { inout_logger += DLog::BatchBackend { dlog::BlockFileBackend(blockOptions), { } }; }, blockWrite);
+
+    const long long textSize  = GetFileSize(textOptions.fileName);
+    const long long blockSize = GetFileSize(blockOptions.fileName);
+    printf("%-16s text %8.1f ns/message   blocks %8.1f ns/message (logging thread)\n", "write", textWrite, blockWrite);
+    printf("%-16s text %8lld KB           blocks %8lld KB (%.2fx)\n", "size", textSize / 1024, blockSize / 1024, blockSize ? (double(textSize) / double(blockSize)) : 0.0);
+
+    dlog::BlockQuery query;
+    Compare("all", textOptions.fileName, [](const char*) { return true; }, blockOptions.fileName, query);
+
+    query.minLogLevel = DERROR;
+    Compare("errors", textOptions.fileName, [](const char* in_line) { return strstr(in_line, " ERR - ") != nullptr; }, blockOptions.fileName, query);
+
+    query = dlog::BlockQuery();
+    query.categories.push_back(DSTRING("audit"));
+    Compare("category", textOptions.fileName, [](const char* in_line) { return strstr(in_line, "[audit]") != nullptr; }, blockOptions.fileName, query);
+
+    query = dlog::BlockQuery();
+    query.text = DSTRING("deadlock");
+    Compare("text", textOptions.fileName, [](const char* in_line) { return strstr(in_line, "deadlock") != nullptr; }, blockOptions.fileName, query);
+
+    // 1% of the time each file covers, from its middle (they were written one after the other).
+    query = dlog::BlockQuery();
+    query.fromTimestamp = blockSpan.fromTimestamp + ((blockSpan.toTimestamp - blockSpan.fromTimestamp) / 2);
+    query.toTimestamp   = query.fromTimestamp + ((blockSpan.toTimestamp - blockSpan.fromTimestamp) / 100);
+    const int64_t textFrom = textSpan.fromTimestamp + ((textSpan.toTimestamp - textSpan.fromTimestamp) / 2);
+    const std::string from = FormatTimestamp(textFrom), to = FormatTimestamp(textFrom + ((textSpan.toTimestamp - textSpan.fromTimestamp) / 100));
+    Compare("time window", textOptions.fileName, [&](const char* in_line) { return (strncmp(in_line, from.c_str(), from.size()) >= 0) && (strncmp(in_line, to.c_str(), to.size()) <= 0); }, blockOptions.fileName, query);
+    return EXIT_SUCCESS;
+}
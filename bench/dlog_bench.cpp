@@ -0,0 +1,388 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2023 David Caadas Mazo.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE.
+ */
+
+// Measures what DLOG statements cost, as seen by the logging threads:
+// * Per-call latency (mean, p50, p99, p99.9) and throughput for each built-in type, for custom types (through both
+//   kinds of dlogStringifyCustomType) and for filtered-out statements, on a single thread with a null backend.
+// * Structured fields through the JSON and logfmt encoders, and the string escaping kernel on its own.
+// * Scaling from 1 to N producer threads against null, memory, file and shared-memory backends.
+// Latencies include the cost of reading the clock, reported by the "baseline/clock" case. dlog_bench_instrumented
+// runs the same cases with dlogEnableInstrumentation defined, to measure the cost of self-instrumentation.
+//
+// Usage: dlog_bench [--format=text|json|csv] [--threads=N] [--calls=N] [--filter=text] [--dir=path]
+//   --format : text (default) prints a table; json and csv are meant to be stored and compared across releases.
+//   --threads: maximum number of producer threads for the scaling cases (default: hardware concurrency).
+//   --calls  : statements per thread and case (default: 200000).
+//   --filter : only runs the cases whose name contains the given text.
+//   --dir    : directory for the file backend output (default: current directory).
+
+#include <ostream>
+
+#if defined(DLOG_BENCH_INSTRUMENTED)
+struct dlogEnableInstrumentation { };
+#endif//defined(DLOG_BENCH_INSTRUMENTED)
+
+namespace dlog { class Writer; }
+struct Point { int x; int y; };          // Custom type with a dlog::Writer stringifier.
+struct LegacyPoint { int x; int y; };    // Custom type with a stream stringifier.
+void dlogStringifyCustomType(dlog::Writer& inout_writer, const Point& in_value) noexcept;
+void dlogStringifyCustomType(std::ostream& inout_stream, const LegacyPoint& in_value);
+
+#include "../dlog_file_backend.h"
+#include "../dlog_shared_memory.h"
+#include "../dlog_structured.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+void dlogStringifyCustomType(dlog::Writer& inout_writer, const Point& in_value) noexcept
+{
+    inout_writer << '(' << in_value.x << ", " << in_value.y << ')';
+}
+
+void dlogStringifyCustomType(std::ostream& inout_stream, const LegacyPoint& in_value)
+{
+    inout_stream << '(' << in_value.x << ", " << in_value.y << ')';
+}
+
+namespace
+{
+static_assert(std::is_same_v<dlog::TCHARTYPE, char>, "The benchmark uses single-byte characters.");
+
+struct Options
+{
+    std::string format = "text";
+    size_t maxThreads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    size_t calls = 200000;
+    std::string filter;
+    std::string directory = ".";
+};
+
+struct Result
+{
+    std::string name;
+    std::string backend;
+    size_t threads;
+    size_t calls;         // In total, over all threads.
+    double callsPerSecond;
+    double mean;          // Nanoseconds.
+    int64_t p50;
+    int64_t p99;
+    int64_t p999;
+};
+
+// Backend that only copies messages, so that producers contend on something cheap.
+class MemoryBackend final
+{
+public:
+    void operator()(const dlog::TCHARTYPE* in_message, const dlog::TCHARTYPE*) noexcept
+    {
+        const size_t length = strlen(in_message);
+        std::scoped_lock<std::mutex> lock(m_mutex);
+        if ((m_size + length) > k_capacity)
+            m_size = 0;
+        memcpy(m_buffer.get() + m_size, in_message, length);
+        m_size += length;
+    }
+
+private:
+    static constexpr size_t k_capacity = 16 * 1024 * 1024;
+    std::mutex m_mutex;
+    std::unique_ptr<char[]> m_buffer = std::make_unique<char[]>(k_capacity);
+    size_t m_size = 0;
+};
+
+// Shared-memory backend, drained by a collector thread of the same process.
+class SharedMemorySink final
+{
+public:
+    SharedMemorySink()
+    {
+        dlog::SharedMemorySegment::Remove(m_options.name);
+        m_collector = std::make_unique<dlog::SharedMemoryCollector>(m_options);
+        m_backend   = std::make_unique<dlog::SharedMemoryBackend>(m_options);
+        m_thread = std::thread([this]()
+        {
+            while (!m_stop)
+                if (m_collector->Poll([](const dlog::SharedMemoryCollector::Record&) { }) == 0)
+                    std::this_thread::sleep_for(std::chrono::microseconds(100));
+        });
+    }
+
+   ~SharedMemorySink()
+    {
+        m_stop = true;
+        m_thread.join();
+        m_backend.reset();
+        m_collector->Poll([](const dlog::SharedMemoryCollector::Record&) { });
+        if (const uint64_t dropped = m_collector->GetDroppedCount())
+            fprintf(stderr, "scaling/shm: %llu message(s) dropped.\n", (unsigned long long)dropped);
+        m_collector.reset();
+        dlog::SharedMemorySegment::Remove(m_options.name);
+    }
+
+    void operator()(const dlog::TCHARTYPE* in_message, const dlog::TCHARTYPE* in_categoryName) const noexcept { (*m_backend)(in_message, in_categoryName); }
+
+private:
+    const dlog::SharedMemoryOptions m_options = []() { dlog::SharedMemoryOptions options; options.name = "dlog_bench"; options.ringCount = 1; options.slotCount = 1 << 16; return options; }();
+    std::unique_ptr<dlog::SharedMemoryCollector> m_collector;
+    std::unique_ptr<dlog::SharedMemoryBackend> m_backend;
+    std::atomic<bool> m_stop { false };
+    std::thread m_thread;
+};
+
+// Runs in_statement(thread, index) in_calls times on each of in_threadCount threads, timing every call.
+// in_setup(DLog&) configures the logger, which is flushed (and destroyed) before the clock stops.
+template<typename TSETUP, typename TSTATEMENT>
+Result Measure(const char* in_name, const char* in_backend, const size_t in_threadCount, const size_t in_calls, TSETUP&& in_setup, TSTATEMENT&& in_statement)
+{
+    std::vector<int64_t> latencies(in_threadCount * in_calls);
+    std::chrono::steady_clock::time_point start, end;
+    {
+        DLog logger;
+        in_setup(logger);
+
+        // Warms up call sites, categories and thread-local state outside the measurement.
+        for (size_t i = 0; i < 1000; ++i)
+            in_statement(size_t(0), i);
+        logger.Flush();
+
+        std::vector<std::thread> threads;
+        start = std::chrono::steady_clock::now();
+        for (size_t t = 0; t < in_threadCount; ++t)
+        {
+            threads.emplace_back([&, t]()
+            {
+                int64_t* latency = &latencies[t * in_calls];
+                for (size_t i = 0; i < in_calls; ++i)
+                {
+                    const auto before = std::chrono::steady_clock::now();
+                    in_statement(t, i);
+                    latency[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - before).count();
+                }
+            });
+        }
+        for (std::thread& it : threads)
+            it.join();
+        logger.Flush();
+    }
+    end = std::chrono::steady_clock::now();
+
+    double sum = 0.0;
+    for (const int64_t it : latencies)
+        sum += double(it);
+    std::sort(latencies.begin(), latencies.end());
+    return 
+    { 
+        in_name, 
+        in_backend, 
+        in_threadCount, 
+        latencies.size(),
+        double(latencies.size()) / std::chrono::duration<double>(end - start).count(),
+        sum / double(latencies.size()),
+        latencies[latencies.size() / 2],
+        latencies[(latencies.size() * 99) / 100],
+        latencies[(latencies.size() * 999) / 1000]
+    };
+}
+
+void NullBackend(const dlog::TCHARTYPE*, const dlog::TCHARTYPE*) noexcept { }
+
+// Single-threaded case against the null backend.
+template<typename TSTATEMENT>
+void RunCase(const Options& in_options, std::vector<Result>& inout_results, const char* in_name, TSTATEMENT&& in_statement, const int in_logLevel = DINFO)
+{
+    if (strstr(in_name, in_options.filter.c_str()) == nullptr)
+        return;
+    inout_results.push_back(Measure(in_name, "null", 1, in_options.calls, [&](DLog& inout_logger) 
+    { 
+        inout_logger.logLevel = in_logLevel;
+        inout_logger += NullBackend; 
+    }, in_statement));
+}
+
+// Single-threaded case, captured in binary mode, against a structured encoder writing to the null backend.
+template<typename TSTATEMENT>
+void RunStructured(const Options& in_options, std::vector<Result>& inout_results, const char* in_name, const dlog::StructuredFormat in_format, TSTATEMENT&& in_statement)
+{
+    if (strstr(in_name, in_options.filter.c_str()) == nullptr)
+        return;
+    inout_results.push_back(Measure(in_name, "null", 1, in_options.calls, [&](DLog& inout_logger) 
+    { 
+        inout_logger.captureMode = dlog::CaptureMode::Binary;
+        inout_logger += dlog::StructuredEncoder(in_format, NullBackend); 
+    }, in_statement));
+}
+
+void RunScaling(const Options& in_options, std::vector<Result>& inout_results, const char* in_backend)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "scaling/%s", in_backend);
+    if (strstr(name, in_options.filter.c_str()) == nullptr)
+        return;
+    const std::string fileName = in_options.directory + "/dlog_bench.log";
+    for (size_t threadCount = 1; ; threadCount = std::min(threadCount * 2, in_options.maxThreads))
+    {
+        inout_results.push_back(Measure(name, in_backend, threadCount, in_options.calls, [&](DLog& inout_logger)
+        {
+            if (strcmp(in_backend, "null") == 0)
+                inout_logger += NullBackend;
+            else if (strcmp(in_backend, "memory") == 0)
+            {
+                std::shared_ptr<MemoryBackend> backend = std::make_shared<MemoryBackend>();
+                inout_logger += [backend](const dlog::TCHARTYPE* in_message, const dlog::TCHARTYPE* in_categoryName) { (*backend)(in_message, in_categoryName); };
+            }
+            else if (strcmp(in_backend, "shm") == 0)
+            {
+                std::shared_ptr<SharedMemorySink> sink = std::make_shared<SharedMemorySink>();
+                inout_logger += [sink](const dlog::TCHARTYPE* in_message, const dlog::TCHARTYPE* in_categoryName) { (*sink)(in_message, in_categoryName); };
+            }
+            else
+            {
+                dlog::FileOptions fileOptions;
+                fileOptions.fileName = fileName;
+                inout_logger += dlog::FileBackend(fileOptions);
+            }
+        }, [](const size_t in_thread, const size_t in_index) 
+        { 
+            DLOG(DINFO) << "Thread " << in_thread << " message " << in_index << " value=" << (double(in_index) * 0.5); 
+        }));
+        if (threadCount == in_options.maxThreads)
+            break;
+    }
+    remove(fileName.c_str());
+}
+
+void PrintText(const std::vector<Result>& in_results)
+{
+    printf("%-24s %-8s %7s %12s %10s %8s %8s %8s\n", "case", "backend", "threads", "calls/s", "mean ns", "p50 ns", "p99 ns", "p99.9 ns");
+    for (const Result& it : in_results)
+        printf("%-24s %-8s %7zu %12.0f %10.1f %8lld %8lld %8lld\n", it.name.c_str(), it.backend.c_str(), it.threads, it.callsPerSecond, it.mean, (long long)it.p50, (long long)it.p99, (long long)it.p999);
+}
+
+void PrintJson(const Options& in_options, const std::vector<Result>& in_results)
+{
+    printf("{\n  \"benchmark\": \"dlog_bench\",\n  \"timestamp\": %lld,\n  \"callsPerThread\": %zu,\n  \"debug\": %s,\n  \"results\": [\n", 
+        (long long)std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count(), 
+        in_options.calls, dlog::is_debug_target_v ? "true" : "false");
+    for (size_t i = 0; i < in_results.size(); ++i)
+    {
+        const Result& it = in_results[i];
+        printf("    { \"case\": \"%s\", \"backend\": \"%s\", \"threads\": %zu, \"calls\": %zu, \"callsPerSecond\": %.0f, \"meanNs\": %.1f, \"p50Ns\": %lld, \"p99Ns\": %lld, \"p999Ns\": %lld }%s\n",
+            it.name.c_str(), it.backend.c_str(), it.threads, it.calls, it.callsPerSecond, it.mean, (long long)it.p50, (long long)it.p99, (long long)it.p999, ((i + 1) < in_results.size()) ? "," : "");
+    }
+    printf("  ]\n}\n");
+}
+
+void PrintCsv(const std::vector<Result>& in_results)
+{
+    printf("case,backend,threads,calls,callsPerSecond,meanNs,p50Ns,p99Ns,p999Ns\n");
+    for (const Result& it : in_results)
+        printf("%s,%s,%zu,%zu,%.0f,%.1f,%lld,%lld,%lld\n", it.name.c_str(), it.backend.c_str(), it.threads, it.calls, it.callsPerSecond, it.mean, (long long)it.p50, (long long)it.p99, (long long)it.p999);
+}
+
+bool ParseOptions(const int argc, char** argv, Options& out_options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* argument = argv[i];
+        const char* value = strchr(argument, '=');
+        if (!value)
+            return false;
+        const std::string key(argument, value++);
+        if      (key == "--format" ) out_options.format     = value;
+        else if (key == "--threads") out_options.maxThreads = std::max<size_t>(strtoull(value, nullptr, 10), 1);
+        else if (key == "--calls"  ) out_options.calls      = std::max<size_t>(strtoull(value, nullptr, 10), 1);
+        else if (key == "--filter" ) out_options.filter     = value;
+        else if (key == "--dir"    ) out_options.directory  = value;
+        else return false;
+    }
+    return (out_options.format == "text") || (out_options.format == "json") || (out_options.format == "csv");
+}
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        fprintf(stderr, "Usage: %s [--format=text|json|csv] [--threads=N] [--calls=N] [--filter=text] [--dir=path]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const std::string text(32, 'x');
+    const Point point { 12, 34 };
+    const LegacyPoint legacyPoint { 12, 34 };
+    std::vector<Result> results;
+    DLog::SetLogLevel(DSTRING("bench.disabled"), DWARNING);
+    RunCase(options, results, "baseline/clock"     , [](size_t, size_t) { });
+    RunCase(options, results, "filtered/level"     , [](size_t, size_t in_index) { DLOG(DINFO) << "Filtered out " << in_index; }, DWARNING);
+    RunCase(options, results, "filtered/category"  , [](size_t, size_t in_index) { DLOG(DINFO, "bench.disabled") << "Filtered out " << in_index; });
+    RunCase(options, results, "type/literal"       , [](size_t, size_t) { DLOG(DINFO) << "Literal"; });
+    RunCase(options, results, "type/bool"          , [](size_t, size_t in_index) { DLOG(DINFO) << ((in_index & 1) != 0); });
+    RunCase(options, results, "type/char"          , [](size_t, size_t in_index) { DLOG(DINFO) << char('a' + (in_index % 26)); });
+    RunCase(options, results, "type/int"           , [](size_t, size_t in_index) { DLOG(DINFO) << -int(in_index); });
+    RunCase(options, results, "type/uint64"        , [](size_t, size_t in_index) { DLOG(DINFO) << (uint64_t(in_index) << 32); });
+    RunCase(options, results, "type/float"         , [](size_t, size_t in_index) { DLOG(DINFO) << (float(in_index) * 0.25f); });
+    RunCase(options, results, "type/double"        , [](size_t, size_t in_index) { DLOG(DINFO) << (double(in_index) * 0.1); });
+    RunCase(options, results, "type/long_double"   , [](size_t, size_t in_index) { DLOG(DINFO) << ((long double)in_index * 0.1L); });
+    RunCase(options, results, "type/pointer"       , [&](size_t, size_t in_index) { DLOG(DINFO) << (text.data() + (in_index & 15)); });
+    RunCase(options, results, "type/nullptr"       , [](size_t, size_t) { DLOG(DINFO) << nullptr; });
+    RunCase(options, results, "type/c_string"      , [&](size_t, size_t) { DLOG(DINFO) << text.c_str(); });
+    RunCase(options, results, "type/string"        , [&](size_t, size_t) { DLOG(DINFO) << text; });
+    RunCase(options, results, "type/string_view"   , [&](size_t, size_t) { DLOG(DINFO) << dlog::TSTRINGVIEW(text); });
+    RunCase(options, results, "custom/writer"      , [&](size_t, size_t) { DLOG(DINFO) << point; });
+    RunCase(options, results, "custom/stream"      , [&](size_t, size_t) { DLOG(DINFO) << legacyPoint; });
+    RunCase(options, results, "mixed"              , [](size_t, size_t in_index) { DLOG(DINFO) << "Message " << in_index << " value=" << (double(in_index) * 0.5) << ' ' << true; });
+    RunCase(options, results, "format/dlogf"       , [](size_t, size_t in_index) { DLOGF(DINFO, "Message {} value={} {}", in_index, (double(in_index) * 0.5), true); });
+    // Ten tags of request context, re-stringified by every statement versus rendered once by a ContextScope.
+    RunCase(options, results, "context/manual_10"  , [&](size_t, size_t in_index)
+    {
+        DLOG(DINFO) << "request=" << 123456789 << " user=" << text << " session=" << 42u << " region=" << "eu-west-1" << " shard=" << 7
+                    << " tenant=" << 1001 << " trace=" << 0xABCDEF01u << " span=" << 17 << " retry=" << false << " version=" << 3.5 << ' ' << "Message " << in_index;
+    });
+    RunCase(options, results, "context/scope_10"   , [&](size_t, size_t in_index)
+    {
+        thread_local const dlog::ContextScope t_context(DLOG_KV("request", 123456789), dlog::kv("user", text), DLOG_KV("session", 42u), DLOG_KV("region", "eu-west-1"), DLOG_KV("shard", 7),
+                                                        DLOG_KV("tenant", 1001), DLOG_KV("trace", 0xABCDEF01u), DLOG_KV("span", 17), DLOG_KV("retry", false), DLOG_KV("version", 3.5));
+        DLOG(DINFO) << "Message " << in_index;
+    });
+    // Mostly plain text, with a few characters to escape.
+    const std::string payload = [&]() { std::string it; while (it.size() < 1024) it += "The quick brown fox jumps over the lazy dog, the \"quick\" brown fox jumps over the lazy dog again.\n"; return it; }();
+    const auto structured = [&](size_t, size_t in_index) { DLOG(DINFO) << "Request served." << DLOG_KV("latency_us", in_index) << DLOG_KV("ok", true) << DLOG_KV("payload", payload); };
+    RunStructured(options, results, "structured/json"  , dlog::StructuredFormat::Json  , structured);
+    RunStructured(options, results, "structured/logfmt", dlog::StructuredFormat::Logfmt, structured);
+    RunCase(options, results, "escape/scalar_1k"   , [&](size_t, size_t) { thread_local dlog::Writer t_out; t_out.Clear(); dlog::AppendEscapedJson(t_out, payload); });
+    RunCase(options, results, "escape/kernel_1k"   , [&](size_t, size_t) { thread_local dlog::Writer t_out; t_out.Clear(); dlog::AppendJsonString(t_out, payload); });
+    RunScaling(options, results, "null");
+    RunScaling(options, results, "memory");
+    RunScaling(options, results, "file");
+    RunScaling(options, results, "shm");
+
+    if      (options.format == "json") PrintJson(options, results);
+    else if (options.format == "csv" ) PrintCsv(results);
+    else PrintText(results);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,137 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2023 David Caadas Mazo.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE.
+ */
+
+// Compares the naive fprintf backend (see README.md) with dlog::FileBackend, in buffered and memory-mapped modes.
+// Reports throughput and per-call latency percentiles, as seen by the logging threads.
+//
+// Usage: file_backend_bench [threads] [messages per thread] [output directory]
+
+#include "../dlog_file_backend.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace
+{
+struct Result
+{
+    double megabytesPerSecond;
+    int64_t p50;
+    int64_t p99;
+    int64_t p999;
+};
+
+template<typename TSETUP>
+Result Run(const size_t in_threadCount, const size_t in_messageCount, TSETUP in_setup)
+{
+    std::vector<int64_t> latencies(in_threadCount * in_messageCount);
+    const std::string payload(96, 'x');
+    std::chrono::steady_clock::time_point start, end;
+    {
+        DLog logger;
+        in_setup(logger);
+
+        std::vector<std::thread> threads;
+        start = std::chrono::steady_clock::now();
+        for (size_t t = 0; t < in_threadCount; ++t)
+        {
+            threads.emplace_back([&, t]()
+            {
+                int64_t* latency = &latencies[t * in_messageCount];
+                for (size_t i = 0; i < in_messageCount; ++i)
+                {
+                    const auto before = std::chrono::steady_clock::now();
+                    DLOG(DINFO) << "Thread " << t << " message " << i << ' ' << payload << " value=" << (i * 0.5);
+                    latency[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - before).count();
+                }
+            });
+        }
+        for (std::thread& it : threads)
+            it.join();
+    }   // Destroying the logger writes everything out.
+    end = std::chrono::steady_clock::now();
+
+    // Approximate size of each line: the payload plus the numbers and the literals.
+    const size_t bytes = latencies.size() * (payload.size() + 40);
+    std::sort(latencies.begin(), latencies.end());
+    const double seconds = std::chrono::duration<double>(end - start).count();
+    return 
+    { 
+        (bytes / (1024.0 * 1024.0)) / seconds,
+        latencies[latencies.size() / 2],
+        latencies[(latencies.size() * 99) / 100],
+        latencies[(latencies.size() * 999) / 1000]
+    };
+}
+
+void Print(const char* in_name, const Result& in_result)
+{
+    printf("%-24s %10.1f MB/s   p50 %8lld ns   p99 %8lld ns   p99.9 %8lld ns\n", in_name, in_result.megabytesPerSecond, (long long)in_result.p50, (long long)in_result.p99, (long long)in_result.p999);
+}
+}
+
+int main(int argc, char** argv)
+{
+    const size_t threadCount  = (argc > 1) ? (size_t)std::atoi(argv[1]) : 4;
+    const size_t messageCount = (argc > 2) ? (size_t)std::atoi(argv[2]) : 250000;
+    const std::string directory = (argc > 3) ? argv[3] : ".";
+    printf("%zu thread(s), %zu message(s) per thread.\n", threadCount, messageCount);
+
+    const std::string naiveFileName = directory + "/bench_naive.log";
+    Print("fprintf (naive)", Run(threadCount, messageCount, [&](DLog& inout_logger)
+    {
+        // Same as the README backend, but writing to a file.
+        static std::mutex s_mutex;
+        static FILE* s_file = nullptr;
+        if (s_file)
+            fclose(s_file);
+#if defined(_MSC_VER)
+#       pragma warning(suppress: 4996) // This function or variable may be unsafe. Consider using fopen_s instead.
+#endif//defined(_MSC_VER)
+        s_file = fopen(naiveFileName.c_str(), "w");
+        inout_logger += [](const dlog::TCHARTYPE* in_message, const dlog::TCHARTYPE*) 
+        { 
+            std::scoped_lock<std::mutex> lock(s_mutex);
+            fputs(in_message, s_file);
+            fflush(s_file);
+        };
+    }));
+
+    dlog::FileOptions options;
+    options.fileName = directory + "/bench_buffered.log";
+    Print("FileBackend (buffered)", Run(threadCount, messageCount, [&](DLog& inout_logger) { inout_logger += dlog::FileBackend(options); }));
+
+    options.fileName = directory + "/bench_mapped.log";
+    options.memoryMapped = true;
+    Print("FileBackend (mapped)", Run(threadCount, messageCount, [&](DLog& inout_logger) { inout_logger += dlog::FileBackend(options); }));
+
+    options.fileName = directory + "/bench_batched.log";
+    options.memoryMapped = false;
+    Print("FileBackend (async)", Run(threadCount, messageCount, [&](DLog& inout_logger) 
+    { 
+        inout_logger += DLog::BatchBackend { dlog::FileBackend(options), { } }; 
+        inout_logger.EnableAsync(); 
+    }));
+    return EXIT_SUCCESS;
+}
@@ -24,11 +24,29 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
+#include <ctime>
 #include <functional>
+#include <limits>
 #include <iomanip>
+#include <memory>
+#include <mutex>
 #include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
 static constexpr int DINFO    = 1000;
 static constexpr int DWARNING = 3000;
@@ -38,6 +56,14 @@ static constexpr int DFATAL   = 9000;
 
 struct dlogAllocatorType;
 struct dlogDisableLogger;
+struct dlogEnableInstrumentation;
+struct dlogInlineBufferSize;
+struct dlogMinLogLevel;
+struct dlogMaxCategories;
+
+// Never-matching placeholder so that ::dlogStringifyCustomType can be looked up when no custom types are defined.
+struct dlogNoCustomType;
+void dlogStringifyCustomType(const dlogNoCustomType&);
 
 namespace dlog
 {
@@ -51,6 +77,11 @@ template<typename TCONFIGTYPE, typename TDEFAULTIMPLICITTYPE> struct configured_
 template<typename TCONFIGTYPE, typename TDEFAULTIMPLICITTYPE> struct configured_type<TCONFIGTYPE, TDEFAULTIMPLICITTYPE, 1> { using type = typename TCONFIGTYPE::type; };
 template<typename TCONFIGTYPE, typename TDEFAULTIMPLICITTYPE, int NISCONFIGTYPECOMPLETE> using  configured_type_t = typename configured_type<TCONFIGTYPE, TDEFAULTIMPLICITTYPE, NISCONFIGTYPECOMPLETE>::type;
 
+template<typename TCONFIGTYPE, auto NDEFAULTIMPLICITVALUE, int NISCONFIGTYPECOMPLETE> struct configured_value;
+template<typename TCONFIGTYPE, auto NDEFAULTIMPLICITVALUE> struct configured_value<TCONFIGTYPE, NDEFAULTIMPLICITVALUE, 0> { static constexpr auto value = NDEFAULTIMPLICITVALUE; };
+template<typename TCONFIGTYPE, auto NDEFAULTIMPLICITVALUE> struct configured_value<TCONFIGTYPE, NDEFAULTIMPLICITVALUE, 1> { static constexpr auto value = TCONFIGTYPE::value; };
+template<typename TCONFIGTYPE, auto NDEFAULTIMPLICITVALUE, int NISCONFIGTYPECOMPLETE> inline constexpr auto configured_value_v = configured_value<TCONFIGTYPE, NDEFAULTIMPLICITVALUE, NISCONFIGTYPECOMPLETE>::value;
+
 #if defined(USE_WIDE_CHAR) || defined(UNICODE) || defined(_UNICODE)
 using TCHARTYPE     = wchar_t;
 #define DSTRING(in_string)  L##in_string
@@ -59,78 +90,1732 @@ using TCHARTYPE     = char;
 #define DSTRING(in_string)  in_string
 #endif//defined(USE_WIDE_CHAR) || defined(UNICODE) || defined(_UNICODE)
 
-using TSTRING       = std::basic_string      <TCHARTYPE, std::char_traits<TCHARTYPE>, configured_type_t<dlogAllocatorType, std::allocator<TCHARTYPE>, is_type_complete_v<dlogAllocatorType>>>;
-using TSTRINGSTREAM = std::basic_stringstream<TCHARTYPE, std::char_traits<TCHARTYPE>, configured_type_t<dlogAllocatorType, std::allocator<TCHARTYPE>, is_type_complete_v<dlogAllocatorType>>>;
+using TALLOCATOR    = configured_type_t<dlogAllocatorType, std::allocator<TCHARTYPE>, is_type_complete_v<dlogAllocatorType>>;
+using TSTRING       = std::basic_string      <TCHARTYPE, std::char_traits<TCHARTYPE>, TALLOCATOR>;
+using TSTRINGSTREAM = std::basic_stringstream<TCHARTYPE, std::char_traits<TCHARTYPE>, TALLOCATOR>;
 using TSTRINGVIEW   = std::basic_string_view <TCHARTYPE>;
 
+static constexpr size_t k_inlineBufferSize = configured_value_v<dlogInlineBufferSize, size_t(256), is_type_complete_v<dlogInlineBufferSize>>;
+static constexpr int    k_minLogLevel      = configured_value_v<dlogMinLogLevel, int(0), is_type_complete_v<dlogMinLogLevel>>;
+static constexpr size_t k_maxCategories    = configured_value_v<dlogMaxCategories, size_t(1024), is_type_complete_v<dlogMaxCategories>>;
+static constexpr bool   k_instrumentationEnabled = is_type_complete_v<dlogEnableInstrumentation>;
+
 #ifndef NDEBUG
 static constexpr bool is_debug_target_v = true ;
 #else
 static constexpr bool is_debug_target_v = false;
 #endif//NDEBUG
 
+template<typename>   struct is_tstring : std::false_type { };
+template<typename T> struct is_tstring<std::basic_string<TCHARTYPE, std::char_traits<TCHARTYPE>, T>> : std::true_type { };
+template<typename T> inline constexpr bool is_tstring_v = is_tstring<T>::value;
+
+// Character buffer used to build log messages. The first k_inlineBufferSize characters (configurable through
+// dlogInlineBufferSize) live inside the object itself; longer messages spill to the heap.
+class Writer final
+{
+public:
+    Writer() noexcept = default;
+   ~Writer() { Release(); }
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+    Writer(Writer&& inout_other) noexcept { MoveFrom(inout_other); }
+    Writer& operator=(Writer&& inout_other) noexcept
+    {
+        if (this != &inout_other)
+        {
+            Release();
+            MoveFrom(inout_other);
+        }
+        return *this;
+    }
+
+    const TCHARTYPE* Data() const noexcept { return m_data; }
+    size_t           Size() const noexcept { return m_size; }
+    TSTRINGVIEW      View() const noexcept { return TSTRINGVIEW(m_data, m_size); }
+    bool       IsInline() const noexcept { return m_data == m_inline; }
+    void            Clear()       noexcept { m_size = 0; }
+
+    // Null-terminated contents. The terminator is not part of Size().
+    const TCHARTYPE* CStr() noexcept
+    {
+        Reserve(1)[0] = TCHARTYPE(0);
+        return m_data;
+    }
+
+    // Returns room for (at least) in_count characters past the end. Call Commit() with the amount actually written.
+    TCHARTYPE* Reserve(const size_t in_count) noexcept
+    {
+        if ((m_size + in_count) > m_capacity)
+            Grow(m_size + in_count);
+        return m_data + m_size;
+    }
+
+    void Commit(const size_t in_count) noexcept { m_size += in_count; }
+
+    void Append(const TCHARTYPE in_char) noexcept
+    {
+        if (m_size == m_capacity)
+            Grow(m_size + 1);
+        m_data[m_size++] = in_char;
+    }
+
+    void Append(const TCHARTYPE* in_data, const size_t in_count) noexcept
+    {
+        std::char_traits<TCHARTYPE>::copy(Reserve(in_count), in_data, in_count);
+        m_size += in_count;
+    }
+
+    void Append(const TSTRINGVIEW in_string) noexcept { Append(in_string.data(), in_string.size()); }
+
+    // Appends single-byte (ASCII) text, widening it if needed.
+    void AppendNarrow(const char* in_data, const size_t in_count) noexcept
+    {
+        if constexpr (std::is_same_v<TCHARTYPE, char>)
+            Append(reinterpret_cast<const TCHARTYPE*>(in_data), in_count);
+        else
+        {
+            TCHARTYPE* out = Reserve(in_count);
+            for (size_t i = 0; i < in_count; ++i)
+                out[i] = TCHARTYPE((unsigned char)in_data[i]);
+            m_size += in_count;
+        }
+    }
+
+    // Appends the raw bytes of a trivially copyable value, padded up to a whole number of characters.
+    template<typename T>
+    void AppendPod(const T& in_value) noexcept
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        constexpr size_t count = (sizeof(T) + sizeof(TCHARTYPE) - 1) / sizeof(TCHARTYPE);
+        TCHARTYPE* out = Reserve(count);
+        memcpy(out, &in_value, sizeof(T));
+        m_size += count;
+    }
+
+    template<typename T> Writer& operator<<(const T& in_value) noexcept;
+
+private:
+    TCHARTYPE* m_data = m_inline;
+    size_t m_size = 0;
+    size_t m_capacity = k_inlineBufferSize;
+    TCHARTYPE m_inline[k_inlineBufferSize];
+
+    void Grow(const size_t in_minCapacity) noexcept
+    {
+        size_t capacity = m_capacity * 2;
+        while (capacity < in_minCapacity)
+            capacity *= 2;
+        TALLOCATOR allocator;
+        TCHARTYPE* data = std::allocator_traits<TALLOCATOR>::allocate(allocator, capacity);
+        std::char_traits<TCHARTYPE>::copy(data, m_data, m_size);
+        Release();
+        m_data = data;
+        m_capacity = capacity;
+    }
+
+    void Release() noexcept
+    {
+        if (m_data != m_inline)
+        {
+            TALLOCATOR allocator;
+            std::allocator_traits<TALLOCATOR>::deallocate(allocator, m_data, m_capacity);
+        }
+        m_data = m_inline;
+        m_capacity = k_inlineBufferSize;
+    }
+
+    void MoveFrom(Writer& inout_other) noexcept
+    {
+        m_size = inout_other.m_size;
+        if (inout_other.m_data == inout_other.m_inline)
+            std::char_traits<TCHARTYPE>::copy(m_inline, inout_other.m_inline, m_size);
+        else
+        {
+            m_data = inout_other.m_data;
+            m_capacity = inout_other.m_capacity;
+            inout_other.m_data = inout_other.m_inline;
+            inout_other.m_capacity = k_inlineBufferSize;
+        }
+        inout_other.m_size = 0;
+    }
+};
+
+// Writes the JSON escape sequence of in_char (or the character itself, if it needs none) into out_buffer, which
+// must hold 6 characters. Returns the number of characters written.
+constexpr size_t EscapeJsonChar(const TCHARTYPE in_char, TCHARTYPE* out_buffer) noexcept
+{
+    constexpr char k_digits[] = "0123456789abcdef";
+    const TCHARTYPE shortForm = (in_char == TCHARTYPE('"')) ? TCHARTYPE('"') : (in_char == TCHARTYPE('\\')) ? TCHARTYPE('\\') : (in_char == TCHARTYPE('\n')) ? TCHARTYPE('n') : 
+                                (in_char == TCHARTYPE('\r')) ? TCHARTYPE('r') : (in_char == TCHARTYPE('\t')) ? TCHARTYPE('t') : TCHARTYPE(0);
+    if (shortForm)
+    {
+        out_buffer[0] = TCHARTYPE('\\');
+        out_buffer[1] = shortForm;
+        return 2;
+    }
+    if (std::make_unsigned_t<TCHARTYPE>(in_char) < 0x20)
+    {
+        out_buffer[0] = TCHARTYPE('\\'); out_buffer[1] = TCHARTYPE('u'); out_buffer[2] = TCHARTYPE('0'); out_buffer[3] = TCHARTYPE('0');
+        out_buffer[4] = TCHARTYPE(k_digits[in_char >> 4]);
+        out_buffer[5] = TCHARTYPE(k_digits[in_char & 0xF]);
+        return 6;
+    }
+    out_buffer[0] = in_char;
+    return 1;
+}
+
+// Scalar, meant for short texts such as keys (see dlog_structured.h for long ones).
+inline void AppendEscapedJson(Writer& inout_writer, const TSTRINGVIEW in_text) noexcept
+{
+    TCHARTYPE escaped[6] = { };
+    for (const TCHARTYPE it : in_text)
+        inout_writer.Append(escaped, EscapeJsonChar(it, escaped));
+}
+
+// Name of a structured field (see kv), kept as is for text and escaped for JSON at compile time. Declared through
+// DLOG_KEY("name").
+class Key final
+{
+public:
+    static constexpr size_t k_maxSize = 64; // In escaped characters.
+
+    template<size_t N>
+    explicit constexpr Key(const TCHARTYPE (&in_name)[N]) : m_name { }, m_escapedName { }, m_size(0), m_escapedSize(0)
+    {
+        TCHARTYPE escaped[6] = { };
+        for (size_t i = 0; (i + 1) < N; ++i)
+        {
+            const size_t size = EscapeJsonChar(in_name[i], escaped);
+            if ((m_escapedSize + size) > k_maxSize)
+                throw Exception(); // Fails to compile: the key is too long.
+            for (size_t j = 0; j < size; ++j)
+                m_escapedName[m_escapedSize++] = escaped[j];
+            m_name[m_size++] = in_name[i];
+        }
+    }
+
+    constexpr TSTRINGVIEW GetName() const noexcept { return TSTRINGVIEW(m_name, m_size); }
+    constexpr TSTRINGVIEW GetEscapedName() const noexcept { return TSTRINGVIEW(m_escapedName, m_escapedSize); }
+
+private:
+    TCHARTYPE m_name[k_maxSize];
+    TCHARTYPE m_escapedName[k_maxSize];
+    size_t m_size;
+    size_t m_escapedSize;
+};
+
+// Structured field, as built by kv(). Refers to its value, so it can't outlive the statement.
+template<typename T>
+struct KeyValue
+{
+    TSTRINGVIEW key;
+    TSTRINGVIEW escapedKey; // Empty if the key was given as a string: escaped on demand.
+    const T& value;
+
+    void AppendEscapedKey(Writer& inout_writer) const noexcept { escapedKey.empty() ? AppendEscapedJson(inout_writer, key) : inout_writer.Append(escapedKey); }
+};
+
+template<typename>   struct is_key_value : std::false_type { };
+template<typename T> struct is_key_value<KeyValue<T>> : std::true_type { };
+template<typename T> inline constexpr bool is_key_value_v = is_key_value<T>::value;
+
+// DLOG(DINFO) << "Request served." << dlog::kv(DLOG_KEY("latency_us"), latency) (or DLOG_KV("latency_us", latency)).
+// Values go through the same stringifiers as any other operand. Keys given as strings are escaped on every call.
+template<typename T> KeyValue<T> kv(const Key& in_key, const T& in_value) noexcept { return { in_key.GetName(), in_key.GetEscapedName(), in_value }; }
+template<typename T> KeyValue<T> kv(const TSTRINGVIEW in_key, const T& in_value) noexcept { return { in_key, TSTRINGVIEW(), in_value }; }
+
+template<typename T>
+inline void WriteInteger(Writer& inout_writer, const T in_value) noexcept
+{
+    char buffer[24];
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), in_value);
+    inout_writer.AppendNarrow(buffer, result.ptr - buffer);
+}
+
+template<typename T>
+inline void WriteFloat(Writer& inout_writer, const T in_value) noexcept
+{
+    char buffer[64];
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), in_value);
+    inout_writer.AppendNarrow(buffer, result.ptr - buffer);
+}
+
+inline void WritePointer(Writer& inout_writer, const void* in_value) noexcept
+{
+    static constexpr char k_digits[] = "0123456789ABCDEF";
+    static constexpr size_t k_count = sizeof(const void*) * 2;
+    TCHARTYPE* out = inout_writer.Reserve(k_count + 2);
+    out[0] = TCHARTYPE('0');
+    out[1] = TCHARTYPE('x');
+    uintptr_t value = (uintptr_t)in_value;
+    for (size_t i = k_count + 1; i > 1; --i, value >>= 4)
+        out[i] = TCHARTYPE(k_digits[value & 0xF]);
+    inout_writer.Commit(k_count + 2);
+}
+
 template<typename = void, typename... TARGS> struct has_customtype_stringifier : std::false_type { };
 template<typename... TARGS> struct has_customtype_stringifier<std::void_t<decltype(::dlogStringifyCustomType(std::declval<TARGS>()...))>, TARGS...> : std::true_type { };
 template<typename... TARGS> inline constexpr bool has_customtype_stringifier_v = has_customtype_stringifier<void, TARGS...>::value;
 
-template<typename T>
-void InvokeCustomTypeStringifier(TSTRINGSTREAM& inout_stream, const T in_value) 
-{
-    static_assert(has_customtype_stringifier_v<TSTRINGSTREAM&, const T&>, "Missing dlogStringifyCustomType implementation for the given type. Check compiler error(s) for details.");
-    if constexpr (has_customtype_stringifier_v<TSTRINGSTREAM&, const T&>)
-        ::dlogStringifyCustomType(inout_stream,  in_value);
-}
-}// dlog.
+// Custom stringifiers should take a dlog::Writer&. Those taking a TSTRINGSTREAM& are still supported,
+// at the cost of building a temporary stream.
+template<typename T>
+void InvokeCustomTypeStringifier(Writer& inout_writer, const T& in_value) 
+{
+    static_assert(has_customtype_stringifier_v<Writer&, const T&> || has_customtype_stringifier_v<TSTRINGSTREAM&, const T&>, "Missing dlogStringifyCustomType implementation for the given type. Check compiler error(s) for details.");
+    if constexpr (has_customtype_stringifier_v<Writer&, const T&>)
+        ::dlogStringifyCustomType(inout_writer, in_value);
+    else if constexpr (has_customtype_stringifier_v<TSTRINGSTREAM&, const T&>)
+    {
+        TSTRINGSTREAM stream;
+        ::dlogStringifyCustomType(stream, in_value);
+        inout_writer.Append(stream.str());
+    }
+}
+}// dlog.
+
+using DLOGLEVELTOSTRFUNC = std::function<void(dlog::TSTRINGSTREAM&, const int)>;
+
+template<typename T, typename TRETURNTYPE = std::enable_if_t< std::is_fundamental_v<std::remove_reference_t<std::remove_cv_t<T>>> ||  std::is_pointer_v<T> ||  std::is_array_v<T>, void>> 
+inline TRETURNTYPE dlogStringifyBuiltInType(dlog::Writer& inout_writer, const T in_value) noexcept
+{
+    using   TBARETYPE = std::remove_reference_t<std::remove_cv_t<T>>;
+    if      constexpr (std::is_same_v<TBARETYPE, bool>) inout_writer.Append(in_value ? DSTRING("true") : DSTRING("false"));
+    else if constexpr (std::is_same_v<TBARETYPE, std::nullptr_t>) inout_writer.Append(DSTRING("nullptr"));
+    else if constexpr (std::is_same_v<TBARETYPE, dlog::TCHARTYPE>) inout_writer.Append(in_value);
+    else if constexpr (std::is_same_v<TBARETYPE, char> || std::is_same_v<TBARETYPE, signed char> || std::is_same_v<TBARETYPE, unsigned char>) inout_writer.Append(dlog::TCHARTYPE((unsigned char)in_value));
+    else if constexpr (std::is_integral_v<TBARETYPE>) dlog::WriteInteger(inout_writer, in_value);
+    else if constexpr (std::is_floating_point_v<TBARETYPE>) dlog::WriteFloat(inout_writer, in_value);
+    else if constexpr (std::is_same_v<TBARETYPE, const dlog::TCHARTYPE*> || std::is_same_v<TBARETYPE, dlog::TCHARTYPE*>) inout_writer.Append(in_value ? dlog::TSTRINGVIEW(in_value) : dlog::TSTRINGVIEW(DSTRING("(null)")));
+    else if constexpr (std::is_same_v<TBARETYPE, const char*> || std::is_same_v<TBARETYPE, char*>) in_value ? inout_writer.AppendNarrow(in_value, std::char_traits<char>::length(in_value)) : inout_writer.Append(DSTRING("(null)"));
+    else if constexpr (std::is_pointer_v    <TBARETYPE>) dlog::WritePointer(inout_writer, (const void*)in_value);
+    else dlog::InvokeCustomTypeStringifier(inout_writer, in_value);
+}
+
+template<typename T, typename TRETURNTYPE = std::enable_if_t<!std::is_fundamental_v<std::remove_reference_t<std::remove_cv_t<T>>> && !std::is_pointer_v<T> && !std::is_array_v<T>>> 
+inline void dlogStringifyBuiltInType(dlog::Writer& inout_writer, const T& in_value) noexcept
+{
+    using   TBARETYPE = std::remove_reference_t<std::remove_cv_t<T>>;
+    if      constexpr (dlog::is_tstring_v<TBARETYPE>) inout_writer.Append(in_value.data(), in_value.size());
+    else if constexpr (std::is_same_v<TBARETYPE, std::remove_cv_t<const dlog::TSTRINGVIEW>>) inout_writer.Append(in_value);
+    else if constexpr (dlog::is_key_value_v<TBARETYPE>)
+    {
+        // " key=value", separated from the previous operand.
+        if (inout_writer.Size() && (inout_writer.Data()[inout_writer.Size() - 1] != dlog::TCHARTYPE(' ')))
+            inout_writer.Append(dlog::TCHARTYPE(' '));
+        inout_writer.Append(in_value.key);
+        inout_writer.Append(dlog::TCHARTYPE('='));
+        ::dlogStringifyBuiltInType(inout_writer, in_value.value);
+    }
+    else dlog::InvokeCustomTypeStringifier(inout_writer, in_value);
+}
+
+// Kept for custom stringifiers written against TSTRINGSTREAM.
+template<typename T>
+inline void dlogStringifyBuiltInType(dlog::TSTRINGSTREAM& inout_stream, const T& in_value) noexcept
+{
+    dlog::Writer writer;
+    ::dlogStringifyBuiltInType(writer, in_value);
+    inout_stream.write(writer.Data(), writer.Size());
+}
+
+template<typename T>
+inline dlog::Writer& dlog::Writer::operator<<(const T& in_value) noexcept
+{
+    ::dlogStringifyBuiltInType(*this, in_value);
+    return *this;
+}
+
+namespace dlog
+{
+// Static description of a DLOG statement. Binary records refer to it instead of carrying its contents.
+struct CallSite
+{
+    const char* fileName;
+    int line;
+    int logLevel;
+};
+
+enum class CaptureMode
+{
+    Text,   // Operands are converted to text by the logging thread.
+    Binary, // Operands are copied raw by the logging thread and converted to text on dispatch (or offline).
+};
+
+// Binary capture format: every operand is stored as a one-character tag followed by its payload, padded up to
+// whole characters. Types without a raw representation (custom types) are converted to text eagerly.
+enum class ArgumentTag : uint8_t
+{
+    Bool, Char, Null, Signed, Unsigned, Float, Double, LongDouble, Pointer, String, 
+    Key, // Name of a structured field, laid out as two Strings under a single tag: as is, then JSON-escaped. Its
+         // value is the next operand.
+};
+
+// Value passed by VisitArguments for Key operands.
+struct KeyView
+{
+    TSTRINGVIEW name;
+    TSTRINGVIEW escapedName;
+};
+
+class ContextNode;
+
+struct BinaryRecord
+{
+    const CallSite* callSite;
+    int64_t timestamp; // Nanoseconds since the system_clock epoch.
+    const TCHARTYPE* categoryName;
+    const TCHARTYPE* arguments;
+    size_t argumentsSize; // In characters.
+    const ContextNode* context = nullptr; // Thread context of the statement (see ContextScope), or null.
+};
+
+template<typename T>
+inline bool ReadPod(const TCHARTYPE*& inout_cursor, const TCHARTYPE* in_end, T& out_value) noexcept
+{
+    constexpr size_t count = (sizeof(T) + sizeof(TCHARTYPE) - 1) / sizeof(TCHARTYPE);
+    if (size_t(in_end - inout_cursor) < count)
+        return false;
+    memcpy(&out_value, inout_cursor, sizeof(T));
+    inout_cursor += count;
+    return true;
+}
+
+inline void EncodeTag(Writer& inout_writer, const ArgumentTag in_tag) noexcept { inout_writer.Append(TCHARTYPE(in_tag)); }
+
+// Text is appended in place by in_append(Writer&) and its length patched afterwards.
+template<typename TFUNC>
+inline void EncodeText(Writer& inout_writer, TFUNC&& in_append) noexcept
+{
+    const size_t lengthOffset = inout_writer.Size();
+    inout_writer.AppendPod(uint32_t(0));
+    const size_t textOffset = inout_writer.Size();
+    in_append(inout_writer);
+    const uint32_t length = uint32_t(inout_writer.Size() - textOffset);
+    memcpy(const_cast<TCHARTYPE*>(inout_writer.Data()) + lengthOffset, &length, sizeof(length));
+}
+
+template<typename TFUNC>
+inline void EncodeText(Writer& inout_writer, const ArgumentTag in_tag, TFUNC&& in_append) noexcept
+{
+    EncodeTag(inout_writer, in_tag);
+    EncodeText(inout_writer, std::forward<TFUNC>(in_append));
+}
+
+template<typename T>
+inline void EncodeArgument(Writer& inout_writer, const T& in_value) noexcept
+{
+    using   TBARETYPE = std::remove_reference_t<std::remove_cv_t<T>>;
+    if      constexpr (std::is_same_v<TBARETYPE, bool>) { EncodeTag(inout_writer, ArgumentTag::Bool); inout_writer.Append(TCHARTYPE(in_value)); }
+    else if constexpr (std::is_same_v<TBARETYPE, std::nullptr_t>) EncodeTag(inout_writer, ArgumentTag::Null);
+    else if constexpr (std::is_same_v<TBARETYPE, TCHARTYPE>) { EncodeTag(inout_writer, ArgumentTag::Char); inout_writer.Append(in_value); }
+    else if constexpr (std::is_same_v<TBARETYPE, char> || std::is_same_v<TBARETYPE, signed char> || std::is_same_v<TBARETYPE, unsigned char>) { EncodeTag(inout_writer, ArgumentTag::Char); inout_writer.Append(TCHARTYPE((unsigned char)in_value)); }
+    else if constexpr (std::is_integral_v<TBARETYPE> && std::is_signed_v<TBARETYPE>) { EncodeTag(inout_writer, ArgumentTag::Signed  ); inout_writer.AppendPod((int64_t )in_value); }
+    else if constexpr (std::is_integral_v<TBARETYPE>) { EncodeTag(inout_writer, ArgumentTag::Unsigned); inout_writer.AppendPod((uint64_t)in_value); }
+    else if constexpr (std::is_same_v<TBARETYPE, float      >) { EncodeTag(inout_writer, ArgumentTag::Float     ); inout_writer.AppendPod(in_value); }
+    else if constexpr (std::is_same_v<TBARETYPE, double     >) { EncodeTag(inout_writer, ArgumentTag::Double    ); inout_writer.AppendPod(in_value); }
+    else if constexpr (std::is_same_v<TBARETYPE, long double>) { EncodeTag(inout_writer, ArgumentTag::LongDouble); inout_writer.AppendPod(in_value); }
+    else if constexpr (std::is_pointer_v<TBARETYPE> && !std::is_same_v<TBARETYPE, const TCHARTYPE*> && !std::is_same_v<TBARETYPE, TCHARTYPE*> && !std::is_same_v<TBARETYPE, const char*> && !std::is_same_v<TBARETYPE, char*>)
+    { 
+        EncodeTag(inout_writer, ArgumentTag::Pointer); 
+        inout_writer.AppendPod((uint64_t)(uintptr_t)in_value); 
+    }
+    else if constexpr (is_key_value_v<TBARETYPE>)
+    {
+        EncodeText(inout_writer, ArgumentTag::Key, [&in_value](Writer& inout_text) { inout_text.Append(in_value.key); });
+        EncodeText(inout_writer, [&in_value](Writer& inout_text) { in_value.AppendEscapedKey(inout_text); });
+        EncodeArgument(inout_writer, in_value.value);
+    }
+    else // Strings and custom types.
+        EncodeText(inout_writer, ArgumentTag::String, [&in_value](Writer& inout_text) { ::dlogStringifyBuiltInType(inout_text, in_value); });
+}
+
+// Calls in_visitor(tag, value) for each operand of a binary record, with value as a bool, TCHARTYPE, int64_t,
+// uint64_t, float, double, long double, const void*, std::nullptr_t, TSTRINGVIEW (String) or KeyView (Key).
+// Returns false if the record is malformed.
+template<typename TVISITOR>
+inline bool VisitArguments(const TCHARTYPE* in_arguments, const size_t in_argumentsSize, TVISITOR&& in_visitor) noexcept
+{
+    const TCHARTYPE* cursor = in_arguments;
+    const TCHARTYPE* end    = in_arguments + in_argumentsSize;
+    const auto readText = [&cursor, end](TSTRINGVIEW& out_text) noexcept
+    {
+        uint32_t length = 0;
+        if (!ReadPod(cursor, end, length) || (length > size_t(end - cursor)))
+            return false;
+        out_text = TSTRINGVIEW(cursor, length);
+        cursor += length;
+        return true;
+    };
+    while (cursor < end)
+    {
+        const ArgumentTag tag = ArgumentTag(*(cursor++));
+        bool succeeded = true;
+        switch (tag)
+        {
+        case ArgumentTag::Null      : in_visitor(tag, nullptr); break;
+        case ArgumentTag::Bool      : { TCHARTYPE   value; if ((succeeded = ReadPod(cursor, end, value))) in_visitor(tag, value != TCHARTYPE(0)); } break;
+        case ArgumentTag::Char      : { TCHARTYPE   value; if ((succeeded = ReadPod(cursor, end, value))) in_visitor(tag, value); } break;
+        case ArgumentTag::Signed    : { int64_t     value; if ((succeeded = ReadPod(cursor, end, value))) in_visitor(tag, value); } break;
+        case ArgumentTag::Unsigned  : { uint64_t    value; if ((succeeded = ReadPod(cursor, end, value))) in_visitor(tag, value); } break;
+        case ArgumentTag::Float     : { float       value; if ((succeeded = ReadPod(cursor, end, value))) in_visitor(tag, value); } break;
+        case ArgumentTag::Double    : { double      value; if ((succeeded = ReadPod(cursor, end, value))) in_visitor(tag, value); } break;
+        case ArgumentTag::LongDouble: { long double value; if ((succeeded = ReadPod(cursor, end, value))) in_visitor(tag, value); } break;
+        case ArgumentTag::Pointer   : { uint64_t    value; if ((succeeded = ReadPod(cursor, end, value))) in_visitor(tag, (const void*)(uintptr_t)value); } break;
+        case ArgumentTag::String    : { TSTRINGVIEW value; if ((succeeded = readText(value))) in_visitor(tag, value); } break;
+        case ArgumentTag::Key       : { KeyView     value; if ((succeeded = (readText(value.name) && readText(value.escapedName)))) in_visitor(tag, value); } break;
+        default: succeeded = false; break;
+        }
+        if (!succeeded)
+            return false;
+    }
+    return true;
+}
+
+// Writes an operand, as passed by VisitArguments, as the Text capture mode would have.
+template<typename T>
+inline void WriteArgument(Writer& inout_writer, const T in_value) noexcept
+{
+    if      constexpr (std::is_same_v<T, TSTRINGVIEW> || std::is_same_v<T, TCHARTYPE>) inout_writer.Append(in_value);
+    else if constexpr (std::is_same_v<T, KeyView>) inout_writer.Append(in_value.name);
+    else if constexpr (std::is_same_v<T, bool> || std::is_same_v<T, std::nullptr_t>) ::dlogStringifyBuiltInType(inout_writer, in_value);
+    else if constexpr (std::is_integral_v<T>) WriteInteger(inout_writer, in_value);
+    else if constexpr (std::is_floating_point_v<T>) WriteFloat(inout_writer, in_value);
+    else WritePointer(inout_writer, in_value);
+}
+
+// Converts the operands of a binary record to the same text the Text capture mode would have produced.
+// Returns false if the record is malformed.
+inline bool DecodeArguments(const TCHARTYPE* in_arguments, const size_t in_argumentsSize, Writer& inout_writer) noexcept
+{
+    const size_t start = inout_writer.Size();
+    return VisitArguments(in_arguments, in_argumentsSize, [&inout_writer, start](const ArgumentTag, const auto in_value)
+    {
+        if constexpr (std::is_same_v<decltype(in_value), const KeyView>)
+        {
+            if ((inout_writer.Size() > start) && (inout_writer.Data()[inout_writer.Size() - 1] != TCHARTYPE(' ')))
+                inout_writer.Append(TCHARTYPE(' '));
+            inout_writer.Append(in_value.name);
+            inout_writer.Append(TCHARTYPE('='));
+        }
+        else
+            WriteArgument(inout_writer, in_value);
+    });
+}
+
+// Format strings of DLOGF: "{}" stands for the next argument, "{:x}"/"{:X}" for an integer in hexadecimal and
+// "{:.N}" for a floating point value with N decimals. "{{" and "}}" stand for braces. Format strings are split into
+// pieces at compile time (an ill-formed format string fails to compile).
+enum class FormatConversion : uint8_t { Default, LowerHex, UpperHex, Fixed };
+
+struct FormatPiece
+{
+    uint32_t offset = 0;   // Literal text, into the format string.
+    uint32_t size = 0;
+    int32_t argument = -1; // Index of the argument, or -1 for literal text.
+    FormatConversion conversion = FormatConversion::Default;
+    int32_t precision = 0;
+};
+
+// Fills out_optPieces (when given) and returns the number of pieces.
+constexpr size_t ParseFormat(const TSTRINGVIEW in_format, FormatPiece* out_optPieces)
+{
+    size_t pieceCount = 0;
+    int32_t argumentCount = 0;
+    const auto addLiteral = [&](const size_t in_begin, const size_t in_end) constexpr
+    {
+        if (in_end <= in_begin)
+            return;
+        if (out_optPieces)
+            out_optPieces[pieceCount] = FormatPiece { uint32_t(in_begin), uint32_t(in_end - in_begin), -1, FormatConversion::Default, 0 };
+        ++pieceCount;
+    };
+
+    size_t literal = 0;
+    for (size_t i = 0; i < in_format.size(); )
+    {
+        const TCHARTYPE it = in_format[i];
+        const bool isDoubled = ((i + 1) < in_format.size()) && (in_format[i + 1] == it);
+        if ((it == TCHARTYPE('}')) && !isDoubled)
+            throw Exception(); // Unmatched '}'.
+        if (((it == TCHARTYPE('{')) || (it == TCHARTYPE('}'))) && isDoubled)
+        {
+            addLiteral(literal, i + 1);
+            literal = (i += 2);
+            continue;
+        }
+        if (it != TCHARTYPE('{'))
+        {
+            ++i;
+            continue;
+        }
+
+        addLiteral(literal, i);
+        const size_t close = in_format.find(TCHARTYPE('}'), i);
+        if (close == TSTRINGVIEW::npos)
+            throw Exception(); // Unmatched '{'.
+        FormatPiece piece { 0, 0, argumentCount++, FormatConversion::Default, 0 };
+        const TSTRINGVIEW spec = in_format.substr(i + 1, close - (i + 1));
+        if      (spec == TSTRINGVIEW(DSTRING(":x"))) piece.conversion = FormatConversion::LowerHex;
+        else if (spec == TSTRINGVIEW(DSTRING(":X"))) piece.conversion = FormatConversion::UpperHex;
+        else if ((spec.size() > 2) && (spec.substr(0, 2) == TSTRINGVIEW(DSTRING(":."))))
+        {
+            piece.conversion = FormatConversion::Fixed;
+            for (const TCHARTYPE digit : spec.substr(2))
+            {
+                if ((digit < TCHARTYPE('0')) || (digit > TCHARTYPE('9')) || (piece.precision > 99))
+                    throw Exception(); // Unsupported precision.
+                piece.precision = (piece.precision * 10) + int32_t(digit - TCHARTYPE('0'));
+            }
+        }
+        else if (!spec.empty())
+            throw Exception(); // Unsupported conversion.
+        if (out_optPieces)
+            out_optPieces[pieceCount] = piece;
+        ++pieceCount;
+        literal = i = close + 1;
+    }
+    addLiteral(literal, in_format.size());
+    return pieceCount;
+}
+
+constexpr size_t CountFormatArguments(const FormatPiece* in_pieces, const size_t in_count) noexcept
+{
+    size_t count = 0;
+    for (size_t i = 0; i < in_count; ++i)
+        count += (in_pieces[i].argument >= 0) ? 1 : 0;
+    return count;
+}
+
+// TFORMATSTRING provides the format string through a constexpr static Get() (see DLOG_FORMAT_STRING).
+template<typename TFORMATSTRING>
+struct ParsedFormat
+{
+    static constexpr TSTRINGVIEW k_text = TFORMATSTRING::Get();
+    static constexpr size_t k_pieceCount = ParseFormat(k_text, nullptr);
+    static constexpr std::array<FormatPiece, k_pieceCount> k_pieces = []() constexpr
+    {
+        std::array<FormatPiece, k_pieceCount> pieces = { };
+        ParseFormat(k_text, pieces.data());
+        return pieces;
+    }();
+    static constexpr size_t k_argumentCount = CountFormatArguments(k_pieces.data(), k_pieceCount);
+};
+
+template<FormatConversion NCONVERSION, int NPRECISION, typename T>
+inline void WriteConverted(Writer& inout_writer, const T& in_value) noexcept
+{
+    if constexpr ((NCONVERSION == FormatConversion::LowerHex) || (NCONVERSION == FormatConversion::UpperHex))
+    {
+        static_assert(std::is_integral_v<T> && !std::is_same_v<T, bool>, "DLOGF: {:x} and {:X} take integers.");
+        using TUNSIGNED = std::make_unsigned_t<std::conditional_t<std::is_integral_v<T> && !std::is_same_v<T, bool>, T, int>>;
+        char buffer[24];
+        const auto result = std::to_chars(buffer, buffer + sizeof(buffer), TUNSIGNED(in_value), 16);
+        if constexpr (NCONVERSION == FormatConversion::UpperHex)
+            std::transform(buffer, result.ptr, buffer, [](const char in_char) { return ((in_char >= 'a') && (in_char <= 'f')) ? char(in_char - 'a' + 'A') : in_char; });
+        inout_writer.AppendNarrow(buffer, result.ptr - buffer);
+    }
+    else
+    {
+        static_assert(std::is_floating_point_v<T>, "DLOGF: {:.N} takes floating point values.");
+        char buffer[128];
+        const auto result = std::to_chars(buffer, buffer + sizeof(buffer), in_value, std::chars_format::fixed, NPRECISION);
+        if (result.ec == std::errc())
+            inout_writer.AppendNarrow(buffer, result.ptr - buffer);
+        else
+            WriteFloat(inout_writer, in_value); // Too long in fixed notation.
+    }
+}
+
+// Tags of a thread context (see ContextScope), rendered once when the scope is opened. Nodes are immutable and
+// shared with the messages that refer to them, so that they can outlive their scope (asynchronous mode, batches).
+class ContextNode final
+{
+public:
+    // "key=value " for each tag, outermost scope first.
+    TSTRINGVIEW GetText() const noexcept { return m_text; }
+
+    // The same tags as Key and value operands (see VisitArguments), then a " " String operand, for binary backends.
+    // Placed before the operands of a message, they decode as GetText() followed by the message.
+    TSTRINGVIEW GetArguments() const noexcept { return m_arguments; }
+
+    // Node of the innermost ContextScope open on the calling thread, or null.
+    static const std::shared_ptr<const ContextNode>& GetCurrent() noexcept { return GetCurrentRef(); }
+
+private:
+    friend class ContextScope;
+
+    TSTRING m_text;
+    TSTRING m_arguments;
+    size_t m_tagsSize = 0; // Of m_arguments, without the trailing separator.
+
+    static std::shared_ptr<const ContextNode>& GetCurrentRef() noexcept { thread_local std::shared_ptr<const ContextNode> t_current; return t_current; }
+};
+
+// Tags the messages posted by the calling thread while in scope, on top of those of the scopes already open:
+//     dlog::ContextScope context(DLOG_KV("request", requestId), DLOG_KV("user", userName));
+// Scopes must be closed in reverse order of opening, which RAII does.
+class ContextScope final
+{
+public:
+    template<typename... T>
+    explicit ContextScope(const KeyValue<T>&... in_tags) noexcept
+    {
+        static_assert(sizeof...(T) > 0, "ContextScope: no tags.");
+        std::shared_ptr<const ContextNode>& current = ContextNode::GetCurrentRef();
+        Writer text, arguments;
+        if (current)
+        {
+            text.Append(current->GetText());
+            arguments.Append(current->GetArguments().substr(0, current->m_tagsSize));
+        }
+        ((::dlogStringifyBuiltInType(text, in_tags), text.Append(TCHARTYPE(' ')), EncodeArgument(arguments, in_tags)), ...);
+        const size_t tagsSize = arguments.Size();
+        EncodeText(arguments, ArgumentTag::String, [](Writer& inout_text) { inout_text.Append(TCHARTYPE(' ')); });
+
+        std::shared_ptr<ContextNode> node = std::make_shared<ContextNode>();
+        node->m_text.assign(text.Data(), text.Size());
+        node->m_arguments.assign(arguments.Data(), arguments.Size());
+        node->m_tagsSize = tagsSize;
+        m_previous = std::exchange(current, std::move(node));
+    }
+
+   ~ContextScope() { ContextNode::GetCurrentRef() = std::move(m_previous); }
+    ContextScope(const ContextScope&) = delete;
+    ContextScope& operator=(const ContextScope&) = delete;
+
+private:
+    std::shared_ptr<const ContextNode> m_previous;
+};
+
+// FNV-1a.
+inline uint64_t HashText(const TSTRINGVIEW in_text) noexcept
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (const TCHARTYPE it : in_text)
+        hash = (hash ^ uint64_t(it)) * 1099511628211ull;
+    return hash;
+}
+
+inline int64_t Now() noexcept { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count(); }
+
+// Interned log category. Categories live as long as the program does, so their names can be handed to backends
+// (even asynchronously) by pointer. Each category can override Frontend::logLevel at runtime.
+struct Category final
+{
+    static constexpr int k_inheritLogLevel = std::numeric_limits<int>::min();
+
+    const TCHARTYPE* const name;
+    const uint32_t id;
+    std::atomic<int> logLevel = k_inheritLogLevel;
+
+    Category(const TCHARTYPE* in_name, const uint32_t in_id) noexcept : name(in_name), id(in_id) { ; }
+    int  GetLogLevel(const int in_globalLogLevel) const noexcept { const int level = logLevel.load(std::memory_order_relaxed); return (level == k_inheritLogLevel) ? in_globalLogLevel : level; }
+    void SetLogLevel(const int in_logLevel) noexcept { logLevel.store(in_logLevel, std::memory_order_relaxed); }
+    void ResetLogLevel() noexcept { logLevel.store(k_inheritLogLevel, std::memory_order_relaxed); }
+};
+
+// Process-wide category table (up to dlogMaxCategories entries). Lookups are lock-free; only the first
+// registration of a name takes a lock. Once the table is full, new names map to the default category.
+class CategoryRegistry final
+{
+public:
+    static Category& Intern(const TSTRINGVIEW in_name) noexcept
+    {
+        const size_t hash = size_t(HashText(in_name));
+        if (Category* category = Find(in_name, hash))
+            return *category;
+
+        {
+            std::scoped_lock<std::mutex> lock(s_mutex);
+            // The last free slot is kept for the default category, the fallback once the table is full.
+            const bool isDefault = (in_name == TSTRINGVIEW(DSTRING("default")));
+            const bool isFull = (s_count + ((isDefault || s_hasDefault) ? 0 : 1)) >= k_maxCategories;
+            size_t index = hash % k_maxCategories;
+            for (size_t probes = 0; probes < k_maxCategories; ++probes, index = (index + 1) % k_maxCategories)
+            {
+                Category* category = s_slots[index].load(std::memory_order_acquire);
+                if (!category)
+                {
+                    if (isFull)
+                        break;
+                    // Intentionally never freed: call sites cache category pointers for the lifetime of the program.
+                    TCHARTYPE* storedName = new TCHARTYPE[in_name.size() + 1];
+                    std::char_traits<TCHARTYPE>::copy(storedName, in_name.data(), in_name.size());
+                    storedName[in_name.size()] = TCHARTYPE(0);
+                    category = new Category(storedName, s_count++);
+                    s_slots[index].store(category, std::memory_order_release);
+                    s_hasDefault = s_hasDefault || isDefault;
+                    return *category;
+                }
+                if (TSTRINGVIEW(category->name) == in_name)
+                    return *category;
+            }
+        }
+        return GetDefault(); // Once unlocked, as the first call interns the default category.
+    }
+
+    static Category* Find(const TCHARTYPE* in_name) noexcept { const TSTRINGVIEW name(in_name); return Find(name, size_t(HashText(name))); }
+    static Category& GetDefault() noexcept { static Category& category = Intern(DSTRING("default")); return category; }
+
+    static void SetLogLevel  (const TCHARTYPE* in_name, const int in_logLevel) noexcept { Intern(in_name).SetLogLevel(in_logLevel); }
+    static void ResetLogLevel(const TCHARTYPE* in_name) noexcept { if (Category* category = Find(in_name)) category->ResetLogLevel(); }
+
+    template<typename TFUNC>
+    static void ForEach(TFUNC&& in_function)
+    {
+        for (auto& it : s_slots)
+            if (Category* category = it.load(std::memory_order_acquire))
+                in_function(*category);
+    }
+
+private:
+    inline static std::atomic<Category*> s_slots[k_maxCategories] = { };
+    inline static std::mutex s_mutex;
+    inline static uint32_t s_count = 0;
+    inline static bool s_hasDefault = false;
+
+    static Category* Find(const TSTRINGVIEW in_name, const size_t in_hash) noexcept
+    {
+        size_t index = in_hash % k_maxCategories;
+        for (size_t probes = 0; probes < k_maxCategories; ++probes, index = (index + 1) % k_maxCategories)
+        {
+            Category* category = s_slots[index].load(std::memory_order_acquire);
+            if (!category || (TSTRINGVIEW(category->name) == in_name))
+                return category;
+        }
+        return nullptr;
+    }
+};
+
+// Per-call-site category cache used by DLOG. Constant character arrays (string literals) are interned once and
+// cached; other names (pointers, mutable buffers, TSTRING, TSTRINGVIEW) are looked up on every call, since they may
+// hold different names each time.
+class CategorySite final
+{
+public:
+    Category& Resolve() noexcept { return Cached(DSTRING("default")); }
+
+    template<typename T>
+    Category& Resolve(T&& in_category) noexcept
+    {
+        using   TBARETYPE = std::remove_reference_t<T>;
+        if      constexpr (std::is_same_v<std::remove_cv_t<TBARETYPE>, Category>) return const_cast<Category&>(in_category);
+        else if constexpr (std::is_array_v<TBARETYPE> && std::is_const_v<TBARETYPE>) return Cached(in_category);
+        else return CategoryRegistry::Intern(in_category);
+    }
+
+private:
+    std::atomic<Category*> m_category = nullptr;
+
+    Category& Cached(const TCHARTYPE* in_name) noexcept
+    {
+        Category* category = m_category.load(std::memory_order_acquire);
+        if (!category)
+        {
+            category = &CategoryRegistry::Intern(in_name);
+            m_category.store(category, std::memory_order_release);
+        }
+        return *category;
+    }
+};
+
+// Self-instrumentation, compiled in by defining dlogEnableInstrumentation. Counters live in blocks owned by each
+// thread (one cache line apart, written without atomic read-modify-writes), summed up on demand by GetSnapshot().
+// One in k_sampleInterval messages per thread is also timed: while being built, formatted and handed to each backend.
+class Instrumentation final
+{
+public:
+    static constexpr size_t k_sampleInterval = 256; // Rare enough for timed messages to stay out of the 99th percentile.
+    static constexpr size_t k_maxBackends = 16; // Backends timed per thread. Any others are called, but not timed.
+    static constexpr int k_logLevels[] = { DINFO, DWARNING, DERROR, DDFATAL, DFATAL };
+    static constexpr size_t k_logLevelCount = sizeof(k_logLevels) / sizeof(k_logLevels[0]);
+
+    // Durations in nanoseconds, in power-of-two buckets: bucket i counts durations below 2^i (and not below 2^(i-1)).
+    struct Histogram
+    {
+        static constexpr size_t k_bucketCount = 40;
+        uint64_t buckets[k_bucketCount] = { };
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        uint64_t max = 0;
+
+        double   GetMean() const noexcept { return count ? (double(sum) / double(count)) : 0.0; }
+        // Upper bound of the bucket holding the given percentile (0-100).
+        uint64_t GetPercentile(const double in_percentile) const noexcept
+        {
+            const uint64_t target = uint64_t((double(count) * in_percentile) / 100.0);
+            uint64_t accumulated = 0;
+            for (size_t i = 0; i < k_bucketCount; ++i)
+                if ((accumulated += buckets[i]) > target)
+                    return std::min(uint64_t(1) << i, max);
+            return max;
+        }
+    };
+
+    struct CategoryCount
+    {
+        const TCHARTYPE* name;
+        uint64_t messages;
+    };
+
+    struct BackendHistogram
+    {
+        uint64_t backendId; // See Frontend::BackendHandle.
+        Histogram histogram;
+    };
+
+    struct Snapshot
+    {
+        uint64_t messagesBuilt = 0;    // Statements posted (or suppressed by DLOG_NO_REPEAT) after passing the log level.
+        uint64_t messagesFiltered = 0; // Statements filtered out by the log level of their category.
+        uint64_t bytesProduced = 0;    // Size of the messages built, before formatting.
+        uint64_t messagesPerLogLevel[k_logLevelCount] = { }; // Counted under the highest of k_logLevels not above theirs.
+        std::vector<CategoryCount> messagesPerCategory;       // Categories with messages only.
+        Histogram building;
+        Histogram formatting;
+        std::vector<BackendHistogram> backends;
+    };
+
+    static bool SampleBuilding   () noexcept { return ((++GetThreadCounters().buildingTick   ) % k_sampleInterval) == 0; }
+    static bool SampleDispatching() noexcept { return ((++GetThreadCounters().dispatchingTick) % k_sampleInterval) == 0; }
+
+    static int64_t GetTicks() noexcept { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+    static void CountFiltered() noexcept { Increment(GetThreadCounters().messagesFiltered); }
+
+    static void CountBuilt(const int in_logLevel, const Category& in_category, const size_t in_size) noexcept
+    {
+        ThreadCounters& counters = GetThreadCounters();
+        Increment(counters.messagesBuilt);
+        Increment(counters.bytesProduced, in_size * sizeof(TCHARTYPE));
+        size_t level = 0;
+        while (((level + 1) < k_logLevelCount) && (k_logLevels[level + 1] <= in_logLevel))
+            ++level;
+        Increment(counters.messagesPerLogLevel[level]);
+        if (in_category.id < k_maxCategories)
+            Increment(counters.messagesPerCategory[in_category.id]);
+    }
+
+    static void RecordBuilding  (const int64_t in_startTicks) noexcept { GetThreadCounters().building  .Record(GetTicks() - in_startTicks); }
+    static void RecordFormatting(const int64_t in_startTicks) noexcept { GetThreadCounters().formatting.Record(GetTicks() - in_startTicks); }
+
+    static void RecordBackend(const uint64_t in_backendId, const int64_t in_startTicks) noexcept
+    {
+        const int64_t duration = GetTicks() - in_startTicks;
+        ThreadCounters& counters = GetThreadCounters();
+        for (ThreadCounters::Backend& it : counters.backends)
+        {
+            const uint64_t id = it.id.load(std::memory_order_relaxed);
+            if ((id == in_backendId) || (id == 0))
+            {
+                if (id == 0)
+                    it.id.store(in_backendId, std::memory_order_relaxed);
+                it.histogram.Record(duration);
+                return;
+            }
+        }
+    }
+
+    // Sums up the counters of every thread, including those that have exited.
+    static Snapshot GetSnapshot()
+    {
+        Snapshot snapshot;
+        std::vector<uint64_t> perCategory(k_maxCategories, 0);
+        {
+            std::scoped_lock<std::mutex> lock(s_mutex);
+            for (const ThreadCounters* counters : GetAllCounters())
+            {
+                snapshot.messagesBuilt    += counters->messagesBuilt   .load(std::memory_order_relaxed);
+                snapshot.messagesFiltered += counters->messagesFiltered.load(std::memory_order_relaxed);
+                snapshot.bytesProduced    += counters->bytesProduced   .load(std::memory_order_relaxed);
+                for (size_t i = 0; i < k_logLevelCount; ++i)
+                    snapshot.messagesPerLogLevel[i] += counters->messagesPerLogLevel[i].load(std::memory_order_relaxed);
+                for (size_t i = 0; i < k_maxCategories; ++i)
+                    perCategory[i] += counters->messagesPerCategory[i].load(std::memory_order_relaxed);
+                counters->building  .MergeInto(snapshot.building);
+                counters->formatting.MergeInto(snapshot.formatting);
+                for (const ThreadCounters::Backend& it : counters->backends)
+                {
+                    const uint64_t id = it.id.load(std::memory_order_relaxed);
+                    if (id == 0)
+                        break;
+                    auto backend = std::find_if(snapshot.backends.begin(), snapshot.backends.end(), [id](const BackendHistogram& in_backend) { return in_backend.backendId == id; });
+                    if (backend == snapshot.backends.end())
+                        backend = snapshot.backends.insert(backend, BackendHistogram { id, { } });
+                    it.histogram.MergeInto(backend->histogram);
+                }
+            }
+        }
+        CategoryRegistry::ForEach([&](const Category& in_category)
+        {
+            if ((in_category.id < k_maxCategories) && perCategory[in_category.id])
+                snapshot.messagesPerCategory.push_back({ in_category.name, perCategory[in_category.id] });
+        });
+        return snapshot;
+    }
+
+private:
+    // Only written by the owning thread, so relaxed loads and stores are enough (and cheaper than fetch_add).
+    static void Increment(std::atomic<uint64_t>& inout_counter, const uint64_t in_value = 1) noexcept { inout_counter.store(inout_counter.load(std::memory_order_relaxed) + in_value, std::memory_order_relaxed); }
+
+    struct AtomicHistogram
+    {
+        std::atomic<uint64_t> buckets[Histogram::k_bucketCount] = { };
+        std::atomic<uint64_t> count = 0;
+        std::atomic<uint64_t> sum = 0;
+        std::atomic<uint64_t> max = 0;
+
+        void Record(const int64_t in_duration) noexcept
+        {
+            const uint64_t duration = uint64_t(std::max<int64_t>(in_duration, 0));
+            size_t bucket = 0;
+            while (((bucket + 1) < Histogram::k_bucketCount) && ((uint64_t(1) << bucket) <= duration))
+                ++bucket;
+            Increment(buckets[bucket]);
+            Increment(count);
+            Increment(sum, duration);
+            if (duration > max.load(std::memory_order_relaxed))
+                max.store(duration, std::memory_order_relaxed);
+        }
+
+        void MergeInto(Histogram& inout_histogram) const noexcept
+        {
+            for (size_t i = 0; i < Histogram::k_bucketCount; ++i)
+                inout_histogram.buckets[i] += buckets[i].load(std::memory_order_relaxed);
+            inout_histogram.count += count.load(std::memory_order_relaxed);
+            inout_histogram.sum   += sum  .load(std::memory_order_relaxed);
+            inout_histogram.max    = std::max(inout_histogram.max, max.load(std::memory_order_relaxed));
+        }
+    };
+
+    struct alignas(64) ThreadCounters
+    {
+        struct Backend
+        {
+            std::atomic<uint64_t> id = 0;
+            AtomicHistogram histogram;
+        };
+
+        bool inUse = true;
+        uint64_t buildingTick = 0;
+        uint64_t dispatchingTick = 0;
+        std::atomic<uint64_t> messagesBuilt = 0;
+        std::atomic<uint64_t> messagesFiltered = 0;
+        std::atomic<uint64_t> bytesProduced = 0;
+        std::atomic<uint64_t> messagesPerLogLevel[k_logLevelCount] = { };
+        std::atomic<uint64_t> messagesPerCategory[k_maxCategories] = { };
+        AtomicHistogram building;
+        AtomicHistogram formatting;
+        Backend backends[k_maxBackends];
+    };
+
+    struct ThreadCountersOwner
+    {
+        ThreadCounters* counters = nullptr;
+       ~ThreadCountersOwner()
+        {
+            if (!counters)
+                return;
+            std::scoped_lock<std::mutex> lock(s_mutex);
+            counters->inUse = false;
+        }
+    };
+
+    // Counters are never freed: those of exited threads still add up, and are reused by new threads.
+    inline static std::mutex s_mutex;
+    static std::vector<ThreadCounters*>& GetAllCounters() noexcept { static std::vector<ThreadCounters*>& s_counters = *new std::vector<ThreadCounters*>(); return s_counters; }
+
+    static ThreadCounters& GetThreadCounters() noexcept
+    {
+        thread_local ThreadCountersOwner t_owner;
+        if (!t_owner.counters)
+        {
+            std::scoped_lock<std::mutex> lock(s_mutex);
+            for (ThreadCounters* counters : GetAllCounters())
+                if (!counters->inUse)
+                {
+                    counters->inUse = true;
+                    return *(t_owner.counters = counters);
+                }
+            t_owner.counters = GetAllCounters().emplace_back(new ThreadCounters());
+        }
+        return *t_owner.counters;
+    }
+};
+
+// Statements suppressed by a limiter since its last summary. While some are pending, the limiter is listed
+// process-wide, so that their summary is posted once its call site has been quiet for k_quietPeriod, even if it
+// never logs again (see Frontend::PostPendingSuppressions). Limiters are function-local statics and trivially
+// destructible, so listed ones remain usable until the program ends.
+class SuppressionCounter
+{
+public:
+    static constexpr int64_t k_quietPeriod = 1000000000; // Nanoseconds.
+
+    struct Summary
+    {
+        int logLevel;
+        const Category* category;
+        const CallSite* callSite;
+        const char* reason;
+        uint64_t count;
+        std::shared_ptr<const ContextNode> context; // Of the first statement suppressed since the last summary.
+    };
+
+    // Counts a statement suppressed at the given call site, and lists the limiter unless it already is.
+    void Suppress(const int in_logLevel, const Category& in_category, const CallSite& in_callSite, const char* in_reason, const std::shared_ptr<const ContextNode>& in_context) noexcept
+    {
+        // Sequentially consistent, as TakeSummaries() unlists before taking the count.
+        m_suppressed.fetch_add(1);
+        m_lastSuppressed.store(GetSteadyTime(), std::memory_order_relaxed);
+        if (m_listed.load())
+            return;
+        std::scoped_lock<std::mutex> lock(s_mutex);
+        if (m_listed.load())
+            return;
+        m_summary = { in_logLevel, &in_category, &in_callSite, in_reason, 0, nullptr };
+        m_listed.store(true);
+        s_listed.push_back({ this, in_context });
+        s_hasListed.store(true, std::memory_order_release);
+    }
+
+    // Statements suppressed since the last summary. Resets the count.
+    uint64_t Take() noexcept { return m_suppressed.load(std::memory_order_relaxed) ? m_suppressed.exchange(0) : 0; }
+
+    // Unlists the limiters quiet for k_quietPeriod (all of them if in_all) and returns the summaries they owe.
+    static std::vector<Summary> TakeSummaries(const bool in_all) noexcept
+    {
+        std::vector<Summary> summaries;
+        if (!s_hasListed.load(std::memory_order_acquire))
+            return summaries;
+        std::vector<SuppressionCounter*> counters;
+        {
+            const int64_t now = GetSteadyTime();
+            std::scoped_lock<std::mutex> lock(s_mutex);
+            for (size_t i = 0; i < s_listed.size(); )
+            {
+                SuppressionCounter* counter = s_listed[i].counter;
+                if (!in_all && ((now - counter->m_lastSuppressed.load(std::memory_order_relaxed)) < k_quietPeriod))
+                {
+                    ++i;
+                    continue;
+                }
+                counter->m_listed.store(false); // Before taking the count: statements suppressed meanwhile list it again.
+                summaries.push_back(counter->m_summary);
+                summaries.back().context = std::move(s_listed[i].context);
+                counters.push_back(counter);
+                s_listed[i] = s_listed.back();
+                s_listed.pop_back();
+            }
+            s_hasListed.store(!s_listed.empty(), std::memory_order_relaxed);
+        }
+        for (size_t i = 0; i < counters.size(); ++i)
+            summaries[i].count = counters[i]->Take();
+        summaries.erase(std::remove_if(summaries.begin(), summaries.end(), [](const Summary& in_summary) { return in_summary.count == 0; }), summaries.end());
+        return summaries;
+    }
+
+protected:
+    static int64_t GetSteadyTime() noexcept { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+private:
+    std::atomic<uint64_t> m_suppressed = 0;
+    std::atomic<int64_t> m_lastSuppressed = 0;
+    std::atomic<bool> m_listed = false;
+    Summary m_summary = { };             // Guarded by s_mutex. Without context, to stay trivially destructible.
+
+    inline static std::mutex s_mutex;
+    struct Listed
+    {
+        SuppressionCounter* counter;
+        std::shared_ptr<const ContextNode> context;
+    };
+
+    inline static std::vector<Listed> s_listed;
+    inline static std::atomic<bool> s_hasListed = false;
+};
+
+// Per-call-site limiters used by DLOG_EVERY_N, DLOG_FIRST_N, DLOG_RATE_LIMITED and DLOG_NO_REPEAT. Admit() runs
+// before the message is built. Those that report suppressed statements derive from SuppressionCounter.
+class EveryN final
+{
+public:
+    bool Admit(const uint64_t in_n) noexcept { return (m_count.fetch_add(1, std::memory_order_relaxed) % in_n) == 0; }
+
+private:
+    std::atomic<uint64_t> m_count = 0;
+};
+
+class FirstN final
+{
+public:
+    // Only a load once the limit is reached.
+    bool Admit(const uint64_t in_n) noexcept { return (m_count.load(std::memory_order_relaxed) < in_n) && (m_count.fetch_add(1, std::memory_order_relaxed) < in_n); }
+
+private:
+    std::atomic<uint64_t> m_count = 0;
+};
+
+// Token bucket holding up to in_perSecond tokens, refilled continuously (as a generic cell rate algorithm: the
+// state is the time at which the bucket will be full again).
+class TokenBucket final : public SuppressionCounter
+{
+public:
+    bool Admit(const uint64_t in_perSecond) noexcept
+    {
+        const int64_t now = GetSteadyTime();
+        const int64_t interval = 1000000000 / int64_t(std::max<uint64_t>(in_perSecond, 1));
+        int64_t fullAt = m_fullAt.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            const int64_t base = std::max(fullAt, now);
+            if ((base - now) > (1000000000 - interval))
+                return false;
+            if (m_fullAt.compare_exchange_weak(fullAt, base + interval, std::memory_order_relaxed))
+                return true;
+        }
+    }
+
+private:
+    std::atomic<int64_t> m_fullAt = 0;
+};
+
+// Suppresses messages identical to the previous one from the same call site, for up to a second. Runs once the
+// message is built (its contents are compared by hash).
+class RepeatFilter final : public SuppressionCounter
+{
+public:
+    explicit RepeatFilter(const CallSite& in_callSite) noexcept : callSite(in_callSite) { ; }
+
+    const CallSite& callSite;
+
+    bool Admit(const TSTRINGVIEW in_message) noexcept
+    {
+        const uint64_t hash = HashText(in_message);
+        const int64_t now = GetSteadyTime();
+        if ((m_lastHash.load(std::memory_order_relaxed) == hash) && ((now - m_lastAdmitted.load(std::memory_order_relaxed)) < 1000000000))
+            return false;
+        m_lastHash.store(hash, std::memory_order_relaxed);
+        m_lastAdmitted.store(now, std::memory_order_relaxed);
+        return true;
+    }
+
+private:
+    std::atomic<uint64_t> m_lastHash = 0;
+    std::atomic<int64_t> m_lastAdmitted = 0;
+};
+
+struct FlightRecorderOptions
+{
+    size_t entriesPerThread = 256;
+    size_t entrySize    = 128;    // Characters of captured operands per entry. Longer entries are cut.
+    int    minLogLevel  = DINFO;  // Filtered-out statements at or above this level are captured.
+    int    dumpLogLevel = DERROR; // Posting a statement at or above this level dumps the captured ones first.
+};
+
+// Ring of the last statements filtered out on each thread, captured in binary form (see EncodeArgument) so that
+// nothing is formatted unless they are dumped. Rings are registered process-wide, so that a dump collects the
+// context of every thread. When a thread exits its ring is kept, captured entries included, for the next new thread.
+class FlightRecorder final
+{
+public:
+    struct Entry
+    {
+        const CallSite* callSite = nullptr;
+        const TCHARTYPE* categoryName = nullptr;
+        int64_t timestamp = 0;
+        size_t size = 0;
+        std::shared_ptr<const ContextNode> context;
+    };
+
+    static void Capture(const FlightRecorderOptions& in_options, const CallSite& in_callSite, const TCHARTYPE* in_categoryName, const int64_t in_timestamp, const TSTRINGVIEW in_arguments, const std::shared_ptr<const ContextNode>& in_context) noexcept
+    {
+        Ring& ring = GetThreadRing(in_options);
+        std::scoped_lock<std::mutex> lock(ring.mutex); // Only contended while dumping.
+        const size_t index = (ring.next++) % ring.capacity;
+        TCHARTYPE* arguments = ring.arguments.get() + (index * ring.entrySize);
+        const size_t size = std::min(in_arguments.size(), ring.entrySize);
+        std::char_traits<TCHARTYPE>::copy(arguments, in_arguments.data(), size);
+        ring.entries[index] = Entry { &in_callSite, in_categoryName, in_timestamp, (size < in_arguments.size()) ? Cut(arguments, size) : size, in_context };
+    }
+
+    // Calls in_function(const Entry&, Writer& arguments) for the entries captured by every thread, oldest first,
+    // then forgets them.
+    template<typename TFUNC>
+    static size_t Drain(TFUNC&& in_function) noexcept
+    {
+        struct Drained
+        {
+            Entry entry;
+            Writer arguments;
+        };
+        std::vector<Drained> drained;
+        {
+            std::scoped_lock<std::mutex> lock(s_mutex);
+            for (Ring* ring : s_rings)
+            {
+                std::scoped_lock<std::mutex> ringLock(ring->mutex);
+                for (size_t i = ring->next - std::min(ring->next, ring->capacity); i < ring->next; ++i)
+                {
+                    const size_t index = i % ring->capacity;
+                    Drained& it = drained.emplace_back();
+                    it.entry = std::move(ring->entries[index]);
+                    it.arguments.Append(ring->arguments.get() + (index * ring->entrySize), it.entry.size);
+                }
+                ring->next = 0;
+            }
+        }
+        std::stable_sort(drained.begin(), drained.end(), [](const Drained& in_a, const Drained& in_b) { return in_a.entry.timestamp < in_b.entry.timestamp; });
+        for (Drained& it : drained)
+            in_function(it.entry, it.arguments);
+        return drained.size();
+    }
+
+private:
+    struct Ring
+    {
+        std::mutex mutex;
+        size_t capacity = 0;
+        size_t entrySize = 0;
+        size_t next = 0; // Entries captured since the last dump.
+        bool inUse = true;
+        std::unique_ptr<Entry[]> entries;
+        std::unique_ptr<TCHARTYPE[]> arguments;
+    };
+
+    struct ThreadRing
+    {
+        Ring* ring = nullptr;
+       ~ThreadRing()
+        {
+            if (!ring)
+                return;
+            std::scoped_lock<std::mutex> lock(s_mutex);
+            ring->inUse = false;
+        }
+    };
+
+    // Rings are never freed: there are as many as threads ever ran concurrently, and threads may still log during
+    // static destruction.
+    inline static std::mutex s_mutex;
+    inline static std::vector<Ring*>& s_rings = *new std::vector<Ring*>();
+
+    static Ring& GetThreadRing(const FlightRecorderOptions& in_options) noexcept
+    {
+        thread_local ThreadRing t_threadRing;
+        if (!t_threadRing.ring)
+        {
+            const size_t capacity  = std::max<size_t>(in_options.entriesPerThread, 1);
+            const size_t entrySize = std::max<size_t>(in_options.entrySize, 16);
+            std::scoped_lock<std::mutex> lock(s_mutex);
+            for (Ring* ring : s_rings)
+                if (!ring->inUse && (ring->capacity == capacity) && (ring->entrySize == entrySize))
+                {
+                    ring->inUse = true;
+                    return *(t_threadRing.ring = ring);
+                }
+            Ring* ring = new Ring();
+            ring->capacity  = capacity;
+            ring->entrySize = entrySize;
+            ring->entries   = std::make_unique<Entry[]>(capacity);
+            ring->arguments = std::make_unique<TCHARTYPE[]>(capacity * entrySize);
+            s_rings.push_back(ring);
+            t_threadRing.ring = ring;
+        }
+        return *t_threadRing.ring;
+    }
+
+    // Returns the size of the operands that fit whole into the first in_size characters. The string that crosses
+    // the limit, if any, is shortened in place so that the entry stays decodable.
+    static size_t Cut(TCHARTYPE* inout_arguments, const size_t in_size) noexcept
+    {
+        constexpr auto podSize = [](auto in_value) constexpr { return (sizeof(in_value) + sizeof(TCHARTYPE) - 1) / sizeof(TCHARTYPE); };
+        size_t offset = 0;
+        while (offset < in_size)
+        {
+            size_t size = 1;
+            switch (ArgumentTag(inout_arguments[offset]))
+            {
+            case ArgumentTag::Null      : break;
+            case ArgumentTag::Bool      : 
+            case ArgumentTag::Char      : size += 1; break;
+            case ArgumentTag::Signed    : 
+            case ArgumentTag::Unsigned  : 
+            case ArgumentTag::Pointer   : size += podSize(uint64_t()); break;
+            case ArgumentTag::Float     : size += podSize(float()); break;
+            case ArgumentTag::Double    : size += podSize(double()); break;
+            case ArgumentTag::LongDouble: size += podSize((long double)0); break;
+            case ArgumentTag::String    :
+            case ArgumentTag::Key       : // Two strings, kept whole or not at all.
+            {
+                const bool isKey = (ArgumentTag(inout_arguments[offset]) == ArgumentTag::Key);
+                for (int i = isKey ? 2 : 1; i > 0; --i)
+                {
+                    const size_t lengthOffset = offset + size;
+                    size += podSize(uint32_t());
+                    if ((offset + size) > in_size)
+                        return offset;
+                    uint32_t length = 0;
+                    memcpy(&length, inout_arguments + lengthOffset, sizeof(length));
+                    if ((offset + size + length) > in_size)
+                    {
+                        if (isKey)
+                            return offset;
+                        length = uint32_t(in_size - (offset + size));
+                        memcpy(inout_arguments + lengthOffset, &length, sizeof(length));
+                    }
+                    size += length;
+                }
+                break;
+            }
+            default: return offset;
+            }
+            if ((offset + size) > in_size)
+                return offset;
+            offset += size;
+        }
+        return offset;
+    }
+};
+
+enum class OverflowPolicy
+{
+    Block,      // Producers wait until the consumer thread frees a slot.
+    DropNewest, // The message being posted is discarded.
+    DropOldest, // The oldest queued message is discarded to make room for the new one.
+};
+
+// Bounded multi-producer/multi-consumer queue (D. Vyukov). Every cell carries a sequence number that tells
+// producers and consumers whether the cell is free or ready, so neither side takes a lock.
+// Multiple consumers are needed to let producers evict the oldest message under OverflowPolicy::DropOldest.
+template<typename T>
+class BoundedQueue final
+{
+public:
+    explicit BoundedQueue(const size_t in_capacity)
+    {
+        size_t capacity = 2;
+        while (capacity < in_capacity)
+            capacity <<= 1;
+        m_cells = std::make_unique<Cell[]>(capacity);
+        m_mask  = capacity - 1;
+        for (size_t i = 0; i < capacity; ++i)
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    bool TryPush(T&& inout_value) noexcept
+    {
+        size_t position = m_enqueuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = m_cells[position & m_mask];
+            const intptr_t diff = (intptr_t)cell.sequence.load(std::memory_order_acquire) - (intptr_t)position;
+            if (diff == 0)
+            {
+                if (m_enqueuePos.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    cell.value = std::move(inout_value);
+                    cell.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+                return false;
+            else
+                position = m_enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    bool TryPop(T& out_value) noexcept
+    {
+        size_t position = m_dequeuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = m_cells[position & m_mask];
+            const intptr_t diff = (intptr_t)cell.sequence.load(std::memory_order_acquire) - (intptr_t)(position + 1);
+            if (diff == 0)
+            {
+                if (m_dequeuePos.compare_exchange_weak(position, position + 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+                {
+                    out_value = std::move(cell.value);
+                    cell.sequence.store(position + m_mask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+                return false;
+            else
+                position = m_dequeuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    // Positions are handed out in order: every value pushed before GetEnqueuePosition() returned N has been popped
+    // once GetDequeuePosition() reaches N, including those whose producers had not finished writing them.
+    size_t GetEnqueuePosition() const noexcept { return m_enqueuePos.load(std::memory_order_acquire); }
+    size_t GetDequeuePosition() const noexcept { return m_dequeuePos.load(std::memory_order_acquire); }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> m_cells;
+    size_t m_mask = 0;
+    alignas(64) std::atomic<size_t> m_enqueuePos = 0;
+    alignas(64) std::atomic<size_t> m_dequeuePos = 0;
+};
+
+// Message as seen by batched backends.
+struct Record
+{
+    TSTRINGVIEW message; // Formatted message, including the trailing new line.
+    int logLevel;
+    const TCHARTYPE* categoryName;
+    int64_t timestamp; // Nanoseconds since the system_clock epoch.
+    const ContextNode* context = nullptr; // Thread context of the message (already rendered into it), or null.
+};
+
+// A batch is delivered as soon as any limit is reached. The delay is checked by the consumer thread when idle
+// (asynchronous mode) or on the next message (synchronous mode). Frontend::Flush() delivers pending batches, too.
+struct BatchOptions
+{
+    size_t maxRecords = 1024;
+    size_t maxBytes   = 64 * 1024;
+    std::chrono::milliseconds maxDelay = std::chrono::milliseconds(100);
+};
+
+// Precomputed text of each log level, so that formatters can copy it instead of converting levels on each message.
+// Custom levels can be added (or built-in ones renamed) through Set(). Unknown levels have an empty token.
+class LogLevelTokens final
+{
+public:
+    static constexpr size_t k_maxTokens = 32;
+    static constexpr size_t k_maxTokenSize = 15;
+
+    LogLevelTokens() noexcept
+    {
+        Set(DINFO   , DSTRING("INF"));
+        Set(DWARNING, DSTRING("WRN"));
+        Set(DERROR  , DSTRING("ERR"));
+        Set(DDFATAL , DSTRING("DBG"));
+        Set(DFATAL  , DSTRING("FTL"));
+    }
+
+    // Tokens longer than k_maxTokenSize are truncated. Returns false if there is no room for a new level.
+    bool Set(const int in_logLevel, const TSTRINGVIEW in_token) noexcept
+    {
+        const size_t index = Find(in_logLevel);
+        if (index == m_count)
+        {
+            if (m_count == k_maxTokens)
+                return false;
+            m_tokens[m_count++].logLevel = in_logLevel;
+        }
+        Token& token = m_tokens[index];
+        token.size = std::min(in_token.size(), k_maxTokenSize);
+        std::char_traits<TCHARTYPE>::copy(token.text, in_token.data(), token.size);
+        return true;
+    }
+
+    TSTRINGVIEW Get(const int in_logLevel) const noexcept
+    {
+        const size_t index = Find(in_logLevel);
+        return (index < m_count) ? TSTRINGVIEW(m_tokens[index].text, m_tokens[index].size) : TSTRINGVIEW();
+    }
+
+private:
+    struct Token
+    {
+        int logLevel;
+        size_t size;
+        TCHARTYPE text[k_maxTokenSize];
+    };
+
+    Token m_tokens[k_maxTokens];
+    size_t m_count = 0;
+
+    // Returns m_count if not found.
+    size_t Find(const int in_logLevel) const noexcept
+    {
+        size_t i = 0;
+        while ((i < m_count) && (m_tokens[i].logLevel != in_logLevel))
+            ++i;
+        return i;
+    }
+};
+
+// Built-in prefix formatter: "2023-01-31 23:59:59.999 WRN - ". The date and time are rendered once per second
+// (and thread); only the sub-second digits are written on each message.
+class TimestampFormatter final
+{
+public:
+    explicit TimestampFormatter(const int in_subSecondDigits = 3, const bool in_utc = false) noexcept
+        : m_subSecondDigits(std::clamp(in_subSecondDigits, 0, 9))
+        , m_utc(in_utc)
+    { ; }
+
+    void operator()(Writer& inout_writer, const LogLevelTokens& in_logLevelTokens, const int in_logLevel, const int64_t in_timestamp) const noexcept
+    {
+        AppendTimestamp(inout_writer, in_timestamp);
+        inout_writer.Append(TCHARTYPE(' '));
+        inout_writer.Append(in_logLevelTokens.Get(in_logLevel));
+        inout_writer.AppendNarrow(" - ", 3);
+    }
+
+    // Appends "YYYY-MM-DD HH:MM:SS", plus the sub-second digits if any, of a Frontend timestamp.
+    void AppendTimestamp(Writer& inout_writer, const int64_t in_timestamp) const noexcept
+    {
+        constexpr int64_t k_nanosecondsPerSecond = 1000000000;
+        const int64_t second   = (in_timestamp >= 0) ? (in_timestamp / k_nanosecondsPerSecond) : (((in_timestamp + 1) / k_nanosecondsPerSecond) - 1);
+        const int64_t fraction = in_timestamp - (second * k_nanosecondsPerSecond);
+
+        thread_local Cache t_cache;
+        if ((t_cache.second != second) || (t_cache.owner != this))
+        {
+            t_cache.owner  = this;
+            t_cache.second = second;
+            const std::time_t time = std::time_t(second);
+            std::tm dateTime = { };
+#if defined(_MSC_VER)
+            m_utc ? gmtime_s(&dateTime, &time) : localtime_s(&dateTime, &time);
+#else
+            m_utc ? gmtime_r(&time, &dateTime) : localtime_r(&time, &dateTime);
+#endif//defined(_MSC_VER)
+            TCHARTYPE* out = t_cache.text;
+            out = WriteDigits(out, dateTime.tm_year + 1900, 4); *out++ = TCHARTYPE('-');
+            out = WriteDigits(out, dateTime.tm_mon  + 1   , 2); *out++ = TCHARTYPE('-');
+            out = WriteDigits(out, dateTime.tm_mday       , 2); *out++ = TCHARTYPE(' ');
+            out = WriteDigits(out, dateTime.tm_hour       , 2); *out++ = TCHARTYPE(':');
+            out = WriteDigits(out, dateTime.tm_min        , 2); *out++ = TCHARTYPE(':');
+            out = WriteDigits(out, dateTime.tm_sec        , 2);
+        }
+        inout_writer.Append(t_cache.text, k_dateTimeSize);
+        if (m_subSecondDigits > 0)
+        {
+            int64_t divisor = 1;
+            for (int i = m_subSecondDigits; i < 9; ++i)
+                divisor *= 10;
+            TCHARTYPE* out = inout_writer.Reserve(size_t(m_subSecondDigits) + 1);
+            *out++ = TCHARTYPE('.');
+            WriteDigits(out, fraction / divisor, m_subSecondDigits);
+            inout_writer.Commit(size_t(m_subSecondDigits) + 1);
+        }
+    }
 
-using DLOGLEVELTOSTRFUNC = std::function<void(dlog::TSTRINGSTREAM&, const int)>;
+private:
+    static constexpr size_t k_dateTimeSize = sizeof("YYYY-MM-DD HH:MM:SS") - 1;
 
-template<typename T, typename TRETURNTYPE = std::enable_if_t< std::is_fundamental_v<std::remove_reference_t<std::remove_cv_t<T>>> ||  std::is_pointer_v<T> ||  std::is_array_v<T>, void>> 
-inline TRETURNTYPE dlogStringifyBuiltInType(dlog::TSTRINGSTREAM& inout_stream, const T in_value) noexcept
-{
-    using   TBARETYPE = std::remove_reference_t<std::remove_cv_t<T>>;
-    if      constexpr (std::is_same_v<TBARETYPE, bool>) inout_stream << (in_value ? DSTRING("true") : DSTRING("false"));
-    else if constexpr (std::is_same_v<TBARETYPE, std::remove_cv_t<const dlog::TCHARTYPE* const>>) inout_stream << in_value;
-    else if constexpr (std::is_fundamental_v<TBARETYPE>) inout_stream << in_value;
-    else if constexpr (std::is_pointer_v    <TBARETYPE>) inout_stream << DSTRING("0x") << std::uppercase << std::setfill(DSTRING('0')) << std::setw(sizeof(const void*)) << std::hex << in_value;
-    else dlog::InvokeCustomTypeStringifier(inout_stream, in_value);
-}
+    struct Cache
+    {
+        const TimestampFormatter* owner = nullptr;
+        int64_t second = 0;
+        TCHARTYPE text[k_dateTimeSize];
+    };
 
-template<typename T, typename TRETURNTYPE = std::enable_if_t<!std::is_fundamental_v<std::remove_reference_t<std::remove_cv_t<T>>> && !std::is_pointer_v<T> && !std::is_array_v<T>>> 
-inline void dlogStringifyBuiltInType(dlog::TSTRINGSTREAM& inout_stream, const T& in_value) noexcept
-{
-    using   TBARETYPE = std::remove_reference_t<std::remove_cv_t<T>>;
-    if      constexpr (std::is_same_v<TBARETYPE, std::remove_cv_t<const dlog::TSTRING    >>) inout_stream << in_value;
-    else if constexpr (std::is_same_v<TBARETYPE, std::remove_cv_t<const dlog::TSTRINGVIEW>>) inout_stream << in_value;
-    else dlog::InvokeCustomTypeStringifier(inout_stream, in_value);
-}
+    int m_subSecondDigits;
+    bool m_utc;
+
+    // Writes exactly in_count digits, zero-padded.
+    static TCHARTYPE* WriteDigits(TCHARTYPE* out_text, int64_t in_value, const int in_count) noexcept
+    {
+        for (int i = in_count - 1; i >= 0; --i, in_value /= 10)
+            out_text[i] = TCHARTYPE('0' + (in_value % 10));
+        return out_text + in_count;
+    }
+};
 
-namespace dlog
-{
 struct Frontend final
 {
     using TBACKENDFUNC = std::function<void(const TCHARTYPE*, const TCHARTYPE*)>;
+    using TBINARYBACKENDFUNC = std::function<void(const BinaryRecord&)>;
+    using TBATCHBACKENDFUNC = std::function<void(const Record*, const size_t)>;
+    using TPREFIXFORMATTERFUNC = std::function<void(Writer&, const LogLevelTokens&, const int, const int64_t)>;
+    using TCONTEXTFORMATTERFUNC = std::function<void(Writer&, const ContextNode&)>;
+
+    // Returned when adding a backend, so that it can be removed later on.
+    struct BackendHandle
+    {
+        uint64_t id = 0;
+    };
+
+    // Backend receiving contiguous batches of records, so that it can write many messages at once.
+    struct BatchBackend
+    {
+        TBATCHBACKENDFUNC function;
+        BatchOptions options;
+    };
+
     const TCHARTYPE* newLine = DSTRING("\n");
 
     template<int NLOGLEVEL>
     struct Stream final
     {
-        static constexpr bool k_streamEnabled = !(is_type_complete_v<dlogDisableLogger> || (!is_debug_target_v && (NLOGLEVEL == DDFATAL)));
+        static constexpr bool k_streamEnabled = !(is_type_complete_v<dlogDisableLogger> || (!is_debug_target_v && (NLOGLEVEL == DDFATAL)) || (NLOGLEVEL < k_minLogLevel));
         Stream(const TCHARTYPE* in_categoryName = DSTRING("default")) noexcept
-            : m_baseLogLevel (k_streamEnabled ? (*Frontend::GetInstancePtr()).logLevel : 0)
-            , m_categoryName (in_categoryName) 
+            : m_category     (k_streamEnabled ? CategoryRegistry::Intern(in_categoryName) : CategoryRegistry::GetDefault())
+            , m_baseLogLevel (k_streamEnabled ? m_category.GetLogLevel((*Frontend::GetInstancePtr()).logLevel) : 0)
         { ; }
 
+        Stream(const CallSite& in_callSite, Category& inout_category, RepeatFilter* inout_optRepeatFilter = nullptr) noexcept
+            : m_category     (inout_category)
+            , m_baseLogLevel (k_streamEnabled ? m_category.GetLogLevel((*Frontend::GetInstancePtr()).logLevel) : 0)
+            , m_repeatFilter (inout_optRepeatFilter)
+        { 
+            if constexpr (k_streamEnabled)
+            {
+                const Frontend& frontend = *Frontend::GetInstancePtr();
+                if ((m_baseLogLevel <= NLOGLEVEL) ? (frontend.captureMode == CaptureMode::Binary) : (NLOGLEVEL >= frontend.m_flightRecorderLevel.load(std::memory_order_relaxed)))
+                {
+                    m_callSite  = &in_callSite;
+                    m_timestamp = Now();
+                }
+                if constexpr (k_instrumentationEnabled)
+                    if ((m_baseLogLevel <= NLOGLEVEL) && Instrumentation::SampleBuilding())
+                        m_buildStartTicks = Instrumentation::GetTicks();
+            }
+        }
+
        ~Stream() noexcept 
         { 
             if constexpr (k_streamEnabled)
             {
-                if (m_baseLogLevel <= NLOGLEVEL)
+                if (m_baseLogLevel > NLOGLEVEL)
+                {
+                    if (m_callSite) // Filtered out, but captured by the flight recorder.
+                        FlightRecorder::Capture((*Frontend::GetInstancePtr()).m_flightRecorderOptions, *m_callSite, m_category.name, m_timestamp, m_out.View(), ContextNode::GetCurrent());
+                }
+                else
                 {
                     Frontend& frontend = *Frontend::GetInstancePtr();
-                    m_out  << frontend.newLine;
-                    frontend.Post(m_out.str(), NLOGLEVEL, m_categoryName);
+                    if constexpr (k_instrumentationEnabled)
+                        Instrumentation::CountBuilt(NLOGLEVEL, m_category, m_out.Size());
+                    if (m_repeatFilter)
+                    {
+                        if (!m_repeatFilter->Admit(m_out.View()))
+                        {
+                            m_repeatFilter->Suppress(NLOGLEVEL, m_category, m_repeatFilter->callSite, "repeated", ContextNode::GetCurrent());
+                            return;
+                        }
+                        if (const uint64_t suppressed = m_repeatFilter->Take())
+                            frontend.PostSuppressed(NLOGLEVEL, m_category, m_repeatFilter->callSite, suppressed, "repeated", ContextNode::GetCurrent());
+                    }
+                    if (!m_callSite)
+                        m_out.Append(TSTRINGVIEW(frontend.newLine));
+                    if constexpr (k_instrumentationEnabled)
+                        if (m_buildStartTicks)
+                            Instrumentation::RecordBuilding(m_buildStartTicks);
+                    if ((NLOGLEVEL >= frontend.m_flightRecorderOptions.dumpLogLevel) && frontend.IsFlightRecorderEnabled())
+                        frontend.DumpFlightRecorder();
+                    frontend.Post(std::move(m_out), NLOGLEVEL, m_category.name, m_callSite, m_timestamp, ContextNode::GetCurrent());
                     if constexpr (NLOGLEVEL >= DDFATAL)
+                    {
+                        frontend.Flush();
                         exit(EXIT_FAILURE);
+                    }
                 }
             }
         }
@@ -139,8 +1824,12 @@ struct Frontend final
         TRETURNTYPE& operator<<(const T  in_value) noexcept
         {
             if constexpr (k_streamEnabled)
-                if (m_baseLogLevel <= NLOGLEVEL)
+            {
+                if (m_callSite)
+                    EncodeArgument(m_out, in_value);
+                else if (m_baseLogLevel <= NLOGLEVEL)
                     ::dlogStringifyBuiltInType(m_out, in_value);
+            }
             return  *this;
         }
 
@@ -148,19 +1837,79 @@ struct Frontend final
         Stream& operator<<(const T& in_value) noexcept
         {
             if constexpr (k_streamEnabled)
-                if (m_baseLogLevel <= NLOGLEVEL)
+            {
+                if (m_callSite)
+                    EncodeArgument(m_out, in_value);
+                else if (m_baseLogLevel <= NLOGLEVEL)
                     ::dlogStringifyBuiltInType(m_out, in_value);
+            }
+            return  *this;
+        }
+
+        // Renders a DLOGF statement in a single pass: literal pieces are appended as blocks of known size, and the
+        // arguments through the same stringifiers used by operator<<.
+        template<typename TFORMATSTRING, typename... TARGS>
+        Stream& Format(TFORMATSTRING, const TARGS&... in_arguments) noexcept
+        {
+            using TFORMAT = ParsedFormat<TFORMATSTRING>;
+            static_assert(TFORMAT::k_argumentCount == sizeof...(TARGS), "DLOGF: the number of arguments doesn't match the format string.");
+            if constexpr (k_streamEnabled)
+                if (m_callSite || (m_baseLogLevel <= NLOGLEVEL))
+                    AppendPieces<TFORMAT>(std::make_index_sequence<TFORMAT::k_pieceCount>(), std::forward_as_tuple(in_arguments...));
             return  *this;
         }
 
     private:
+        template<typename TFORMAT, size_t... NPIECES, typename TTUPLE>
+        void AppendPieces(std::index_sequence<NPIECES...>, const TTUPLE& in_arguments) noexcept
+        {
+            (AppendPiece<TFORMAT, NPIECES>(in_arguments), ...);
+        }
+
+        template<typename TFORMAT, size_t NPIECE, typename TTUPLE>
+        void AppendPiece(const TTUPLE& in_arguments) noexcept
+        {
+            static constexpr FormatPiece k_piece = TFORMAT::k_pieces[NPIECE];
+            if constexpr (k_piece.argument < 0)
+            {
+                const TCHARTYPE* text = TFORMAT::k_text.data() + k_piece.offset;
+                if (m_callSite)
+                    EncodeText(m_out, ArgumentTag::String, [text](Writer& inout_text) { inout_text.Append(text, k_piece.size); });
+                else
+                    m_out.Append(text, k_piece.size);
+            }
+            else
+            {
+                const auto& value = std::get<size_t(k_piece.argument)>(in_arguments);
+                if constexpr (k_piece.conversion == FormatConversion::Default)
+                {
+                    if (m_callSite)
+                        EncodeArgument(m_out, value);
+                    else
+                        ::dlogStringifyBuiltInType(m_out, value);
+                }
+                else if (m_callSite)
+                    EncodeText(m_out, ArgumentTag::String, [&value](Writer& inout_text) { WriteConverted<k_piece.conversion, k_piece.precision>(inout_text, value); });
+                else
+                    WriteConverted<k_piece.conversion, k_piece.precision>(m_out, value);
+            }
+        }
+
+        Category& m_category;
         const int m_baseLogLevel;
-        const TCHARTYPE* m_categoryName;
-        TSTRINGSTREAM m_out;
+        const CallSite* m_callSite = nullptr; // Only set when capturing in binary mode, or for the flight recorder.
+        int64_t m_timestamp = 0;
+        RepeatFilter* m_repeatFilter = nullptr;
+        int64_t m_buildStartTicks = 0; // Only set when instrumented and sampled.
+        Writer m_out;
     };
 
-    int logLevel = DINFO;
-    std::function<const TSTRING(const DLOGLEVELTOSTRFUNC, const TSTRING&, const int)> formatter;
+    std::atomic<int> logLevel = DINFO; // Can be changed at any time. Categories can override it (see Category::SetLogLevel).
+    CaptureMode captureMode = CaptureMode::Text;
+    TPREFIXFORMATTERFUNC prefixFormatter; // Appends the prefix (level, timestamp...) of each message. See TimestampFormatter.
+    TCONTEXTFORMATTERFUNC contextFormatter; // Renders the thread context (see ContextScope) between the prefix and the message. Copies ContextNode::GetText() if unset.
+    LogLevelTokens logLevelTokens;
+    std::function<const TSTRING(const DLOGLEVELTOSTRFUNC, const TSTRING&, const int)> formatter; // Legacy, allocates. Takes precedence over prefixFormatter.
     DLOGLEVELTOSTRFUNC logLevelFormatter = [](TSTRINGSTREAM& inout_stream, const int in_logLevel) noexcept
     {
         switch (in_logLevel)
@@ -180,26 +1929,645 @@ struct Frontend final
             throw Exception();
     }
 
-   ~Frontend() { std::atomic_store(&GetInstancePtr(), nullptr); }
-   void operator+= (const TBACKENDFUNC& in_backendFunction) noexcept  { m_backends.push_back(in_backendFunction); }
+   ~Frontend() 
+    { 
+        PostPendingSuppressions(true);
+        DisableAsync(); 
+        Flush(); 
+        std::atomic_store(&GetInstancePtr(), nullptr); 
+        delete m_backends.load(std::memory_order_acquire);
+    }
+
+    // Whether a DLOG(NLOGLEVEL) statement would be posted to the given category. Always false for compiled-out levels.
+    template<int NLOGLEVEL>
+    static bool IsEnabled(const Category& in_category = CategoryRegistry::GetDefault()) noexcept
+    {
+        if constexpr (!Stream<NLOGLEVEL>::k_streamEnabled)
+            return false;
+        else
+        {
+            const Frontend* frontend = GetInstancePtr().load(std::memory_order_relaxed);
+            return frontend && (in_category.GetLogLevel(frontend->logLevel.load(std::memory_order_relaxed)) <= NLOGLEVEL);
+        }
+    }
+
+    // Returns the given category if a DLOG(NLOGLEVEL) statement would be posted to it, nullptr otherwise.
+    // Statements filtered out are still admitted when the flight recorder captures them.
+    template<int NLOGLEVEL>
+    static Category* Admit(Category& inout_category) noexcept 
+    { 
+        if (IsEnabled<NLOGLEVEL>(inout_category))
+            return &inout_category;
+        if constexpr (Stream<NLOGLEVEL>::k_streamEnabled)
+        {
+            if constexpr (k_instrumentationEnabled)
+                Instrumentation::CountFiltered();
+            const Frontend* frontend = GetInstancePtr().load(std::memory_order_relaxed);
+            if (frontend && (NLOGLEVEL >= frontend->m_flightRecorderLevel.load(std::memory_order_relaxed)))
+                return &inout_category;
+        }
+        return nullptr;
+    }
+
+    // Same as Admit(), but also asks the call site limiter. Posts a summary first if statements were suppressed.
+    template<int NLOGLEVEL, typename TLIMITER>
+    static Category* Admit(Category& inout_category, const CallSite& in_callSite, TLIMITER& inout_limiter, const uint64_t in_limit) noexcept
+    {
+        constexpr bool k_countsSuppressed = std::is_base_of_v<SuppressionCounter, TLIMITER>;
+        if (!IsEnabled<NLOGLEVEL>(inout_category))
+        {
+            if constexpr (k_instrumentationEnabled && Stream<NLOGLEVEL>::k_streamEnabled)
+                Instrumentation::CountFiltered();
+            return nullptr;
+        }
+        if (!inout_limiter.Admit(in_limit))
+        {
+            if constexpr (k_countsSuppressed)
+                inout_limiter.Suppress(NLOGLEVEL, inout_category, in_callSite, "rate limited", ContextNode::GetCurrent());
+            return nullptr;
+        }
+        if constexpr (k_countsSuppressed)
+            if (const uint64_t suppressed = inout_limiter.Take())
+                GetInstancePtr().load(std::memory_order_relaxed)->PostSuppressed(NLOGLEVEL, inout_category, in_callSite, suppressed, "rate limited", ContextNode::GetCurrent());
+        return &inout_category;
+    }
+
+    // DLOG statements are expressions: Hold() passes the category that their condition admitted to their Stream. The
+    // Stream takes it before any operand is evaluated, so operands that log themselves can't overwrite it.
+    static bool Hold(Category* in_optCategory) noexcept { s_heldCategory = in_optCategory; return in_optCategory != nullptr; }
+    static Category& TakeHeld() noexcept { return *s_heldCategory; }
+
+    // Lets DLOG turn a whole Stream expression into void so that it can be the operand of a conditional.
+    struct Voidify final
+    {
+        template<int NLOGLEVEL> void operator&(const Stream<NLOGLEVEL>&) const noexcept { ; }
+    };
+
+    // Changes the log level of a category at runtime, lock-free once the category exists.
+    static void SetLogLevel  (const TCHARTYPE* in_categoryName, const int in_logLevel) noexcept { CategoryRegistry::SetLogLevel(in_categoryName, in_logLevel); }
+    static void ResetLogLevel(const TCHARTYPE* in_categoryName) noexcept { CategoryRegistry::ResetLogLevel(in_categoryName); }
+
+    // Backends can be added and removed at any time, even while other threads are logging.
+    BackendHandle operator+= (const TBACKENDFUNC& in_backendFunction) noexcept { return AddBackend(&Backends::text, std::make_shared<const TBACKENDFUNC>(in_backendFunction)); }
+    BackendHandle operator+= (const TBINARYBACKENDFUNC& in_backendFunction) noexcept { return AddBackend(&Backends::binary, std::make_shared<const TBINARYBACKENDFUNC>(in_backendFunction)); }
+    BackendHandle operator+= (const BatchBackend& in_backend) noexcept { return AddBackend(&Backends::batch, std::make_shared<Batch>(in_backend)); }
+
+    // Once this returns, the backend is no longer running nor called again (pending batches are delivered first).
+    // When called from a backend, removal is deferred until the calling thread finishes dispatching the message.
+    void operator-= (const BackendHandle in_handle) noexcept
+    {
+        UpdateBackends([in_handle](Backends& inout_backends)
+        {
+            const auto matches = [in_handle](const auto& in_registered) { return in_registered.id == in_handle.id; };
+            inout_backends.text  .erase(std::remove_if(inout_backends.text  .begin(), inout_backends.text  .end(), matches), inout_backends.text  .end());
+            inout_backends.binary.erase(std::remove_if(inout_backends.binary.begin(), inout_backends.binary.end(), matches), inout_backends.binary.end());
+            inout_backends.batch .erase(std::remove_if(inout_backends.batch .begin(), inout_backends.batch .end(), matches), inout_backends.batch .end());
+        });
+    }
+
+    // Moves formatting and backend dispatching to a dedicated consumer thread. Post() then only pushes the
+    // finished message into a bounded lock-free queue of (at least) in_queueCapacity entries.
+    // Must be called during setup, before logging from other threads. Category names must outlive the frontend.
+    void EnableAsync(const size_t in_queueCapacity = 8192, const OverflowPolicy in_overflowPolicy = OverflowPolicy::Block)
+    {
+        if (m_asyncQueue)
+            throw Exception();
+        m_overflowPolicy = in_overflowPolicy;
+        m_asyncStop.store(false, std::memory_order_relaxed);
+        m_asyncQueue     = std::make_unique<BoundedQueue<AsyncMessage>>(in_queueCapacity);
+        m_asyncThread    = std::thread([this]() { RunConsumer(); });
+        m_asyncThreadId  = m_asyncThread.get_id();
+    }
+
+    // Blocks until every message posted so far has reached the backends, including pending batches, as well as the
+    // summaries of suppressed statements whose call sites have been quiet for a while.
+    void Flush() noexcept
+    {
+        PostPendingSuppressions(false);
+        if (m_asyncQueue && (std::this_thread::get_id() != m_asyncThreadId))
+        {
+            // Messages are tickets: the queue positions they got. Waits until every position handed out so far has
+            // been popped (or evicted), and until the consumer is done dispatching them.
+            const size_t target = m_asyncQueue->GetEnqueuePosition();
+            while ((m_asyncQueue->GetDequeuePosition() < target) || (m_asyncDispatchingFrom.load(std::memory_order_acquire) < target))
+            {
+                WakeConsumer();
+                std::this_thread::yield();
+            }
+        }
+        const BackendsReader backends(*this);
+        for (auto& it : backends->batch)
+            it.backend->Deliver();
+    }
+
+    // Counters and sampled timings of the logging pipeline, process-wide. Empty unless dlogEnableInstrumentation
+    // is defined (see Instrumentation).
+    static Instrumentation::Snapshot GetInstrumentationSnapshot() 
+    { 
+        if constexpr (k_instrumentationEnabled)
+            return Instrumentation::GetSnapshot();
+        else
+            return Instrumentation::Snapshot();
+    }
+
+    // Number of messages discarded so far by the DropNewest and DropOldest overflow policies.
+    uint64_t GetDroppedCount() const noexcept { return m_asyncDropped.load(std::memory_order_relaxed); }
+
+    // Captures the statements filtered out by the log level (down to in_options.minLogLevel) into per-thread rings,
+    // unformatted. They are posted, oldest first, right before any statement at or above in_options.dumpLogLevel
+    // (and so before DDFATAL/DFATAL exit the program). Must be called during setup.
+    void EnableFlightRecorder(const FlightRecorderOptions& in_options = FlightRecorderOptions()) noexcept
+    {
+        m_flightRecorderOptions = in_options;
+        m_flightRecorderLevel.store(in_options.minLogLevel, std::memory_order_relaxed);
+    }
+
+    void DisableFlightRecorder() noexcept { m_flightRecorderLevel.store(std::numeric_limits<int>::max(), std::memory_order_relaxed); }
+    bool IsFlightRecorderEnabled() const noexcept { return m_flightRecorderLevel.load(std::memory_order_relaxed) != std::numeric_limits<int>::max(); }
+
+    // Posts (and forgets) the statements captured so far by the flight recorder.
+    void DumpFlightRecorder() noexcept
+    {
+        FlightRecorder::Drain([this](const FlightRecorder::Entry& in_entry, Writer& inout_arguments)
+        {
+            Post(std::move(inout_arguments), in_entry.callSite->logLevel, in_entry.categoryName, in_entry.callSite, in_entry.timestamp, in_entry.context);
+        });
+    }
 
 private:
-    std::vector<TBACKENDFUNC> m_backends;
-    static std::atomic<Frontend*>& GetInstancePtr() noexcept { static std::atomic<Frontend*> instancePtr; return instancePtr; }
-    void Post(const TSTRING& in_message, const int in_logLevel, const TCHARTYPE* in_optCategoryName) noexcept
+    struct AsyncMessage
+    {
+        Writer message;
+        int logLevel = 0;
+        const TCHARTYPE* categoryName = nullptr;
+        const CallSite* callSite = nullptr;
+        int64_t timestamp = 0;
+        std::shared_ptr<const ContextNode> context;
+    };
+
+    // Records are appended under m_mutex, but delivered after unlocking, so that batch backends can log. Deliveries
+    // are serialized by m_deliveryMutex; those that would start on the thread already delivering the batch (its
+    // backend logs, flushes or raises DFATAL) are skipped, and the records they would deliver wait for the next one.
+    class Batch final
+    {
+    public:
+        explicit Batch(const BatchBackend& in_backend) : m_backend(in_backend) { ; }
+       ~Batch() { Deliver(); } // Removed while records were pending.
+
+        void Append(const Record& in_record, const std::shared_ptr<const ContextNode>& in_context) noexcept
+        {
+            bool isFull = false;
+            {
+                std::scoped_lock<std::mutex> lock(m_mutex);
+                if (m_pending.records.empty())
+                    m_oldest = std::chrono::steady_clock::now();
+                if (in_context)
+                    m_pending.contexts.push_back(in_context);
+                m_pending.offsets.push_back(m_pending.text.size());
+                m_pending.records.push_back(in_record);
+                m_pending.text.append(in_record.message);
+                isFull = (m_pending.records.size() >= m_backend.options.maxRecords) || ((m_pending.text.size() * sizeof(TCHARTYPE)) >= m_backend.options.maxBytes) || IsExpired();
+            }
+            if (isFull)
+                Deliver();
+        }
+
+        void Deliver() noexcept { Deliver(false); }
+        void DeliverIfExpired() noexcept { Deliver(true); }
+
+    private:
+        struct Records
+        {
+            TSTRING text;                // Messages, back to back.
+            std::vector<size_t> offsets; // Offset of each message into text.
+            std::vector<Record> records;
+            std::vector<std::shared_ptr<const ContextNode>> contexts; // Keeps the contexts of the records alive.
+        };
+
+        const BatchBackend m_backend;
+        std::mutex m_mutex;
+        Records m_pending;                                   // Guarded by m_mutex.
+        std::chrono::steady_clock::time_point m_oldest;      // Guarded by m_mutex.
+        std::mutex m_deliveryMutex;
+        Records m_delivering;                                // Guarded by m_deliveryMutex. Keeps its capacity.
+        std::atomic<std::thread::id> m_deliveringThread { };
+
+        bool IsExpired() const noexcept { return !m_pending.records.empty() && ((std::chrono::steady_clock::now() - m_oldest) >= m_backend.options.maxDelay); }
+
+        void Deliver(const bool in_onlyIfExpired) noexcept
+        {
+            if (m_deliveringThread.load(std::memory_order_relaxed) == std::this_thread::get_id())
+                return;
+            std::scoped_lock<std::mutex> deliveryLock(m_deliveryMutex);
+            {
+                std::scoped_lock<std::mutex> lock(m_mutex);
+                if (m_pending.records.empty() || (in_onlyIfExpired && !IsExpired()))
+                    return;
+                std::swap(m_pending, m_delivering);
+            }
+            // text may have been reallocated while appending, so message views are rebuilt here.
+            for (size_t i = 0, l = m_delivering.records.size(); i < l; ++i)
+                m_delivering.records[i].message = TSTRINGVIEW(m_delivering.text.data() + m_delivering.offsets[i], m_delivering.records[i].message.size());
+            m_deliveringThread.store(std::this_thread::get_id(), std::memory_order_relaxed);
+            m_backend.function(m_delivering.records.data(), m_delivering.records.size());
+            m_deliveringThread.store(std::thread::id(), std::memory_order_relaxed);
+            m_delivering.records.clear();
+            m_delivering.offsets.clear();
+            m_delivering.contexts.clear();
+            m_delivering.text.clear();
+        }
+    };
+
+    template<typename T>
+    struct Registered
+    {
+        uint64_t id;
+        std::shared_ptr<T> backend;
+    };
+
+    // Immutable list of backends. Changes publish a modified copy (see UpdateBackends).
+    struct Backends
+    {
+        std::vector<Registered<const TBACKENDFUNC>> text;
+        std::vector<Registered<const TBINARYBACKENDFUNC>> binary;
+        std::vector<Registered<Batch>> batch;
+    };
+
+    struct alignas(64) ReaderCount
+    {
+        std::atomic<uint32_t> value = 0;
+    };
+
+    // Pins the current list of backends while in scope, without locking. Readers register into the counter of the
+    // current epoch; writers advance the epoch, then wait for the counter of the previous one to drain before
+    // releasing the old list.
+    class BackendsReader final
+    {
+    public:
+        explicit BackendsReader(Frontend& inout_frontend) noexcept : m_frontend(inout_frontend)
+        {
+            for (;;)
+            {
+                const uint64_t epoch = m_frontend.m_backendsEpoch.load(std::memory_order_seq_cst);
+                m_readerCount = &m_frontend.m_backendsReaders[epoch & 1].value;
+                m_readerCount->fetch_add(1, std::memory_order_seq_cst);
+                if (m_frontend.m_backendsEpoch.load(std::memory_order_seq_cst) == epoch)
+                    break;
+                m_readerCount->fetch_sub(1, std::memory_order_release); // A writer advanced the epoch meanwhile.
+            }
+            m_backends = m_frontend.m_backends.load(std::memory_order_acquire);
+            ++s_readDepth;
+        }
+
+       ~BackendsReader()
+        {
+            m_readerCount->fetch_sub(1, std::memory_order_release);
+            if ((--s_readDepth == 0) && m_frontend.m_hasDeferredUpdates.load(std::memory_order_acquire))
+                m_frontend.ApplyDeferredUpdates();
+        }
+
+        const Backends* operator->() const noexcept { return m_backends; }
+
+    private:
+        Frontend& m_frontend;
+        std::atomic<uint32_t>* m_readerCount = nullptr;
+        const Backends* m_backends = nullptr;
+    };
+
+    using TUPDATEFUNC = std::function<void(Backends&)>;
+
+    std::atomic<const Backends*> m_backends = new Backends();
+    std::atomic<uint64_t> m_backendsEpoch = 0;
+    ReaderCount m_backendsReaders[2];
+    std::atomic<uint64_t> m_lastBackendId = 0;
+    std::mutex m_backendsMutex;                 // Serializes writers.
+    std::mutex m_deferredUpdatesMutex;
+    std::vector<TUPDATEFUNC> m_deferredUpdates; // Requested from backends, which can't wait for themselves to finish.
+    std::atomic<bool> m_hasDeferredUpdates = false;
+    inline static thread_local uint32_t s_readDepth = 0;
+    inline static thread_local Category* s_heldCategory = nullptr;
+    std::unique_ptr<BoundedQueue<AsyncMessage>> m_asyncQueue;
+    std::thread m_asyncThread;
+    std::thread::id m_asyncThreadId;            // Kept once the thread is detached (see DisableAsync).
+    OverflowPolicy m_overflowPolicy = OverflowPolicy::Block;
+    std::mutex m_asyncMutex;
+    std::condition_variable m_asyncWakeUp;
+    std::atomic<bool> m_asyncStop = false;
+    std::atomic<bool> m_asyncSleeping = false;
+    alignas(64) std::atomic<size_t> m_asyncDispatchingFrom = 0; // Lowest queue position the consumer may still be dispatching.
+    std::atomic<uint64_t> m_asyncDropped = 0;
+    FlightRecorderOptions m_flightRecorderOptions;
+    std::atomic<int> m_flightRecorderLevel = std::numeric_limits<int>::max();
+
+    inline static std::atomic<Frontend*> s_instancePtr = nullptr;
+    static std::atomic<Frontend*>& GetInstancePtr() noexcept { return s_instancePtr; }
+
+    template<typename T>
+    BackendHandle AddBackend(std::vector<Registered<T>> Backends::* in_list, std::shared_ptr<T>&& in_backend) noexcept
+    {
+        const BackendHandle handle { m_lastBackendId.fetch_add(1, std::memory_order_relaxed) + 1 };
+        UpdateBackends([in_list, handle, backend = std::move(in_backend)](Backends& inout_backends) { (inout_backends.*in_list).push_back({ handle.id, backend }); });
+        return handle;
+    }
+
+    // Publishes a modified copy of the list of backends, then waits until no thread can be using the previous one.
+    void UpdateBackends(TUPDATEFUNC&& in_update) noexcept
+    {
+        if (s_readDepth > 0)
+        {
+            std::scoped_lock<std::mutex> lock(m_deferredUpdatesMutex);
+            m_deferredUpdates.push_back(std::move(in_update));
+            m_hasDeferredUpdates.store(true, std::memory_order_release);
+            return;
+        }
+
+        std::unique_ptr<const Backends> previous; // Released unlocked: removed batches deliver their pending records.
+        {
+            std::scoped_lock<std::mutex> lock(m_backendsMutex);
+            std::unique_ptr<Backends> backends = std::make_unique<Backends>(*m_backends.load(std::memory_order_relaxed));
+            in_update(*backends);
+            previous.reset(m_backends.exchange(backends.release(), std::memory_order_seq_cst));
+            const uint64_t epoch = m_backendsEpoch.fetch_add(1, std::memory_order_seq_cst);
+            while (m_backendsReaders[epoch & 1].value.load(std::memory_order_acquire) != 0)
+                std::this_thread::yield();
+        }
+    }
+
+    void ApplyDeferredUpdates() noexcept
+    {
+        std::vector<TUPDATEFUNC> updates;
+        {
+            std::scoped_lock<std::mutex> lock(m_deferredUpdatesMutex);
+            updates.swap(m_deferredUpdates);
+            m_hasDeferredUpdates.store(false, std::memory_order_relaxed);
+        }
+        if (!updates.empty())
+            UpdateBackends([&updates](Backends& inout_backends) { for (auto& it : updates) it(inout_backends); });
+    }
+
+    // in_context: thread context of the statement. It is only referred to, and kept alive while queued or batched.
+    void Post(Writer&& inout_message, const int in_logLevel, const TCHARTYPE* in_optCategoryName, const CallSite* in_optCallSite = nullptr, const int64_t in_timestamp = 0, const std::shared_ptr<const ContextNode>& in_context = nullptr) noexcept
+    {
+        const int64_t timestamp = in_timestamp ? in_timestamp : Now();
+        if (!m_asyncQueue || (std::this_thread::get_id() == m_asyncThreadId))
+        {
+            Dispatch(inout_message, in_logLevel, in_optCategoryName, in_optCallSite, timestamp, in_context, SampleDispatch());
+            return;
+        }
+
+        AsyncMessage asyncMessage { std::move(inout_message), in_logLevel, in_optCategoryName, in_optCallSite, timestamp, in_context };
+        while (!m_asyncQueue->TryPush(std::move(asyncMessage)))
+        {
+            if (m_overflowPolicy == OverflowPolicy::DropNewest)
+            {
+                m_asyncDropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            else if (m_overflowPolicy == OverflowPolicy::DropOldest)
+            {
+                AsyncMessage evicted;
+                if (m_asyncQueue->TryPop(evicted))
+                    m_asyncDropped.fetch_add(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                WakeConsumer();
+                std::this_thread::yield();
+            }
+        }
+        WakeConsumer();
+    }
+
+    // Posts the summaries owed by limiters whose call sites have been quiet for a while (by all of them if in_all).
+    void PostPendingSuppressions(const bool in_all) noexcept
+    {
+        for (const SuppressionCounter::Summary& it : SuppressionCounter::TakeSummaries(in_all))
+            PostSuppressed(it.logLevel, *it.category, *it.callSite, it.count, it.reason, it.context);
+    }
+
+    // "Suppressed 42 message(s) from file.cpp:123 (reason).", as a message of the same level and category.
+    void PostSuppressed(const int in_logLevel, const Category& in_category, const CallSite& in_callSite, const uint64_t in_count, const char* in_reason, const std::shared_ptr<const ContextNode>& in_context) noexcept
+    {
+        Writer message;
+        message << "Suppressed " << in_count << " message(s) from " << in_callSite.fileName << ':' << in_callSite.line << " (" << in_reason << ").";
+        message.Append(TSTRINGVIEW(newLine));
+        Post(std::move(message), in_logLevel, in_category.name, nullptr, 0, in_context);
+    }
+
+    void WakeConsumer() noexcept
+    {
+        if (m_asyncSleeping.load(std::memory_order_acquire))
+        {
+            std::scoped_lock<std::mutex> lock(m_asyncMutex);
+            m_asyncWakeUp.notify_one();
+        }
+    }
+
+    void RunConsumer() noexcept
+    {
+        for (;;)
+        {
+            if (DispatchQueued())
+                continue;
+            if (m_asyncStop.load(std::memory_order_acquire))
+                break;
+            PostPendingSuppressions(false);
+            {
+                const BackendsReader backends(*this);
+                for (auto& it : backends->batch)
+                    it.backend->DeliverIfExpired();
+            }
+
+            // Producers only notify when the consumer is flagged as sleeping; the timeout bounds the latency
+            // of the (benign) race between a producer checking the flag and the consumer setting it.
+            std::unique_lock<std::mutex> lock(m_asyncMutex);
+            m_asyncSleeping.store(true, std::memory_order_release);
+            m_asyncWakeUp.wait_for(lock, std::chrono::milliseconds(1));
+            m_asyncSleeping.store(false, std::memory_order_release);
+        }
+    }
+
+    // Pops and dispatches a queued message, if any. Only called by the consumer thread.
+    bool DispatchQueued() noexcept
+    {
+        // Announced before popping, so that Flush() can't see the message popped before it is dispatched.
+        // Popping synchronizes with Flush(), and a position popped by this thread is never below this one.
+        m_asyncDispatchingFrom.store(m_asyncQueue->GetDequeuePosition(), std::memory_order_release);
+        AsyncMessage asyncMessage;
+        if (!m_asyncQueue->TryPop(asyncMessage))
+            return false;
+        Dispatch(asyncMessage.message, asyncMessage.logLevel, asyncMessage.categoryName, asyncMessage.callSite, asyncMessage.timestamp, asyncMessage.context, SampleDispatch());
+        return true;
+    }
+
+    void DisableAsync() noexcept
+    {
+        if (!m_asyncQueue)
+            return;
+        if (std::this_thread::get_id() == m_asyncThreadId)
+        {
+            // On the consumer thread, which can't join itself: a DFATAL raised by a backend calls exit(), which
+            // destroys the frontend from here. Dispatches what is queued, and lets the thread go.
+            while (DispatchQueued())
+                ;
+            m_asyncStop.store(true, std::memory_order_release);
+            m_asyncThread.detach();
+            return;
+        }
+        Flush();
+        m_asyncStop.store(true, std::memory_order_release);
+        WakeConsumer();
+        m_asyncThread.join();
+        m_asyncQueue.reset();
+        m_asyncThreadId = std::thread::id();
+    }
+
+    // Returns the ticks at which dispatching started if this message is to be timed, 0 otherwise.
+    static int64_t SampleDispatch() noexcept
+    {
+        if constexpr (k_instrumentationEnabled)
+            if (Instrumentation::SampleDispatching())
+                return Instrumentation::GetTicks();
+        return 0;
+    }
+
+    // in_sampleTicks: see SampleDispatch(). Formatting is timed from then until the message reaches the backends.
+    void Dispatch(Writer& inout_message, const int in_logLevel, const TCHARTYPE* in_optCategoryName, const CallSite* in_optCallSite, const int64_t in_timestamp, const std::shared_ptr<const ContextNode>& in_context, const int64_t in_sampleTicks) noexcept
     {
+        const BackendsReader backends(*this);
+        if (in_optCallSite)
+        {
+            // Binary capture: binary backends get the raw record, text backends its decoded form.
+            for (auto& it  : backends->binary)
+            {
+                const int64_t startTicks = in_sampleTicks ? Instrumentation::GetTicks() : 0;
+                (*it.backend)(BinaryRecord { in_optCallSite, in_timestamp, in_optCategoryName, inout_message.Data(), inout_message.Size(), in_context.get() });
+                if (startTicks)
+                    Instrumentation::RecordBackend(it.id, startTicks);
+            }
+            if (backends->text.empty() && backends->batch.empty())
+                return;
+
+            const int64_t formattingTicks = in_sampleTicks ? Instrumentation::GetTicks() : 0;
+            Writer text;
+            if (!DecodeArguments(inout_message.Data(), inout_message.Size(), text))
+                return;
+            text.Append(TSTRINGVIEW(newLine));
+            Dispatch(text, in_logLevel, in_optCategoryName, nullptr, in_timestamp, in_context, formattingTicks);
+            return;
+        }
+
         if (formatter)
         {
-            const TSTRING&& message = formatter(logLevelFormatter, in_message, in_logLevel);
-            for (auto& it  : m_backends)
-                it(message.c_str(), in_optCategoryName);
+            TSTRING text;
+            if (in_context)
+            {
+                Writer context;
+                AppendContext(context, *in_context);
+                text.assign(context.Data(), context.Size());
+            }
+            text.append(inout_message.View());
+            const TSTRING&& message = formatter(logLevelFormatter, text, in_logLevel);
+            if (in_sampleTicks)
+                Instrumentation::RecordFormatting(in_sampleTicks);
+            DispatchText(backends, message.c_str(), message.size(), in_logLevel, in_optCategoryName, in_timestamp, in_context, in_sampleTicks != 0);
+        }
+        else if (prefixFormatter || in_context)
+        {
+            // The prefix and the message are joined in a buffer owned by the thread, so that its capacity is reused.
+            // Nested dispatches (backends that log, on the consumer thread) use a buffer of their own.
+            thread_local Writer t_line;
+            thread_local bool t_lineInUse = false;
+            Writer nestedLine;
+            Writer& line = t_lineInUse ? nestedLine : t_line;
+            const bool lineWasInUse = std::exchange(t_lineInUse, true);
+            line.Clear();
+            if (prefixFormatter)
+                prefixFormatter(line, logLevelTokens, in_logLevel, in_timestamp);
+            if (in_context)
+                AppendContext(line, *in_context);
+            line.Append(inout_message.View());
+            if (in_sampleTicks)
+                Instrumentation::RecordFormatting(in_sampleTicks);
+            DispatchText(backends, line.CStr(), line.Size(), in_logLevel, in_optCategoryName, in_timestamp, in_context, in_sampleTicks != 0);
+            t_lineInUse = lineWasInUse;
+        }
+        else
+        {
+            if (in_sampleTicks)
+                Instrumentation::RecordFormatting(in_sampleTicks);
+            DispatchText(backends, inout_message.CStr(), inout_message.Size(), in_logLevel, in_optCategoryName, in_timestamp, in_context, in_sampleTicks != 0);
         }
+    }
+
+    void AppendContext(Writer& inout_line, const ContextNode& in_context) const noexcept
+    {
+        if (contextFormatter)
+            contextFormatter(inout_line, in_context);
         else
-            for (auto& it  : m_backends)
-                it(in_message.c_str(), in_optCategoryName);
+            inout_line.Append(in_context.GetText());
+    }
+
+    static void DispatchText(const BackendsReader& in_backends, const TCHARTYPE* in_message, const size_t in_size, const int in_logLevel, const TCHARTYPE* in_optCategoryName, const int64_t in_timestamp, const std::shared_ptr<const ContextNode>& in_context, const bool in_sampled) noexcept
+    {
+        for (auto& it  : in_backends->text)
+        {
+            const int64_t startTicks = in_sampled ? Instrumentation::GetTicks() : 0;
+            (*it.backend)(in_message, in_optCategoryName);
+            if (startTicks)
+                Instrumentation::RecordBackend(it.id, startTicks);
+        }
+        if (!in_backends->batch.empty())
+        {
+            const Record record { TSTRINGVIEW(in_message, in_size), in_logLevel, in_optCategoryName, in_timestamp, in_context.get() };
+            for (auto& it  : in_backends->batch)
+            {
+                const int64_t startTicks = in_sampled ? Instrumentation::GetTicks() : 0;
+                it.backend->Append(record, in_context);
+                if (startTicks)
+                    Instrumentation::RecordBackend(it.id, startTicks);
+            }
+        }
     }
 };
 }// dlog.
 
 using DLog = ::dlog::Frontend;
-#define DLOG(in_logLevel, ...) ::DLog::Stream<in_logLevel>(__VA_ARGS__)
+#define DLOG_CALLSITE(in_logLevel) ([]() noexcept -> const ::dlog::CallSite& { static constexpr ::dlog::CallSite k_callSite { __FILE__, __LINE__, in_logLevel }; return k_callSite; }())
+#define DLOG_CATEGORY(...) ([&]() noexcept -> ::dlog::Category& { static ::dlog::CategorySite s_categorySite; return s_categorySite.Resolve(__VA_ARGS__); }())
+#define DLOG_KEY(in_key) ([]() noexcept -> const ::dlog::Key& { static constexpr ::dlog::Key k_key(in_key); return k_key; }())
+#define DLOG_KV(in_key, in_value) ::dlog::kv(DLOG_KEY(in_key), in_value)
+
+// Operands are only evaluated if the statement is going to be posted: filtered-out statements cost one branch,
+// and those below dlogMinLogLevel (or disabled through dlogDisableLogger) are removed at compile time.
+// The optional argument is the category: a string literal (interned once per call site), any other string (a
+// const TCHARTYPE*, a TCHARTYPE buffer, a TSTRING or a TSTRINGVIEW, looked up on each call) or a dlog::Category.
+#define DLOG(in_logLevel, ...) \
+    !(::DLog::Stream<in_logLevel>::k_streamEnabled && ::DLog::Hold(::DLog::Admit<in_logLevel>(DLOG_CATEGORY(__VA_ARGS__)))) ? (void)0 : \
+    ::DLog::Voidify() & ::DLog::Stream<in_logLevel>(DLOG_CALLSITE(in_logLevel), ::DLog::TakeHeld())
+
+// Format string variant: DLOGF(DINFO, "x={} y={:x}", x, y). The format string must be a literal, and is parsed at
+// compile time (see ParsedFormat), as is the number of arguments checked. DLOGF_IN takes a category as well.
+#define DLOG_FORMAT_STRING(in_format) ([]() noexcept { struct FormatString { static constexpr ::dlog::TSTRINGVIEW Get() noexcept { return in_format; } }; return FormatString(); }())
+#define DLOGF(in_logLevel, in_format, ...) \
+    !(::DLog::Stream<in_logLevel>::k_streamEnabled && ::DLog::Hold(::DLog::Admit<in_logLevel>(DLOG_CATEGORY()))) ? (void)0 : \
+    ::DLog::Voidify() & ::DLog::Stream<in_logLevel>(DLOG_CALLSITE(in_logLevel), ::DLog::TakeHeld()).Format(DLOG_FORMAT_STRING(in_format), ##__VA_ARGS__)
+#define DLOGF_IN(in_logLevel, in_category, in_format, ...) \
+    !(::DLog::Stream<in_logLevel>::k_streamEnabled && ::DLog::Hold(::DLog::Admit<in_logLevel>(DLOG_CATEGORY(in_category)))) ? (void)0 : \
+    ::DLog::Voidify() & ::DLog::Stream<in_logLevel>(DLOG_CALLSITE(in_logLevel), ::DLog::TakeHeld()).Format(DLOG_FORMAT_STRING(in_format), ##__VA_ARGS__)
+
+// Rate-limited variants. Their state lives in a static atomic per call site, checked (after the log level) before
+// any operand is evaluated:
+// * DLOG_EVERY_N(level, n)           : logs the 1st, (n+1)th, (2n+1)th... statements.
+// * DLOG_FIRST_N(level, n)           : logs the first n statements only.
+// * DLOG_RATE_LIMITED(level, n)      : logs up to n statements per second (token bucket), then a summary of those suppressed.
+// * DLOG_NO_REPEAT(level)            : drops messages identical to the previous one for up to a second, then logs a summary.
+#define DLOG_LIMITED(in_limiterType, in_limit, in_logLevel, ...) \
+    !(::DLog::Stream<in_logLevel>::k_streamEnabled && ::DLog::Hold(::DLog::Admit<in_logLevel>(DLOG_CATEGORY(__VA_ARGS__), DLOG_CALLSITE(in_logLevel), ([]() noexcept -> in_limiterType& { static in_limiterType s_limiter; return s_limiter; }()), in_limit))) ? (void)0 : \
+    ::DLog::Voidify() & ::DLog::Stream<in_logLevel>(DLOG_CALLSITE(in_logLevel), ::DLog::TakeHeld())
+#define DLOG_EVERY_N(in_logLevel, in_n, ...) DLOG_LIMITED(::dlog::EveryN, in_n, in_logLevel, __VA_ARGS__)
+#define DLOG_FIRST_N(in_logLevel, in_n, ...) DLOG_LIMITED(::dlog::FirstN, in_n, in_logLevel, __VA_ARGS__)
+#define DLOG_RATE_LIMITED(in_logLevel, in_perSecond, ...) DLOG_LIMITED(::dlog::TokenBucket, in_perSecond, in_logLevel, __VA_ARGS__)
+#define DLOG_NO_REPEAT(in_logLevel, ...) \
+    !(::DLog::Stream<in_logLevel>::k_streamEnabled && ::DLog::Hold(::DLog::Admit<in_logLevel>(DLOG_CATEGORY(__VA_ARGS__)))) ? (void)0 : \
+    ::DLog::Voidify() & ::DLog::Stream<in_logLevel>(DLOG_CALLSITE(in_logLevel), ::DLog::TakeHeld(), &([]() noexcept -> ::dlog::RepeatFilter& { static ::dlog::RepeatFilter s_repeatFilter(DLOG_CALLSITE(in_logLevel)); return s_repeatFilter; }()))
@@ -0,0 +1,241 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2023 David Caadas Mazo.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "dlog.h"
+
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+
+// Binary log files written by BinaryFileBackend (Frontend::captureMode = CaptureMode::Binary) and read back by
+// BinaryFileReader (see tools/dlog_decode.cpp). Values are stored in host byte order.
+//
+// File header: magic "DLOGBIN", format version, sizeof(TCHARTYPE) and a byte order mark.
+// Then a sequence of entries, each one starting with its EntryType:
+// * Site    : uint32 id, int32 line, int32 level, uint32 file name length, file name (chars).
+// * Category: uint32 id, uint32 name length, name (TCHARTYPE).
+// * Record  : uint32 site id, uint32 category id, int64 timestamp, uint32 arguments size, arguments (TCHARTYPE).
+// Site and category definitions are written once, right before the first record that uses them.
+
+namespace dlog
+{
+static constexpr char     k_binaryFileMagic[8]     = { 'D', 'L', 'O', 'G', 'B', 'I', 'N', 0 };
+static constexpr uint32_t k_binaryFileVersion      = 2;
+static constexpr uint32_t k_binaryFileByteOrderMark = 0x01020304;
+
+enum class BinaryEntryType : uint8_t { Site = 'S', Category = 'C', Record = 'R' };
+
+class BinaryFileBackend final
+{
+public:
+    explicit BinaryFileBackend(const char* in_fileName, const size_t in_bufferSize = 1 << 20)
+        : m_state(std::make_shared<State>())
+    {
+        m_state->file = fopen(in_fileName, "wb");
+        if (!m_state->file)
+            throw Exception();
+        m_state->buffer.resize(in_bufferSize);
+        setvbuf(m_state->file, m_state->buffer.data(), _IOFBF, m_state->buffer.size());
+        m_state->Write(k_binaryFileMagic, sizeof(k_binaryFileMagic));
+        m_state->WritePod(k_binaryFileVersion);
+        m_state->WritePod(uint32_t(sizeof(TCHARTYPE)));
+        m_state->WritePod(k_binaryFileByteOrderMark);
+    }
+
+    void operator()(const BinaryRecord& in_record) const noexcept
+    {
+        State& state = *m_state;
+        std::scoped_lock<std::mutex> lock(state.mutex);
+
+        auto site = state.siteIds.find(in_record.callSite);
+        if (site == state.siteIds.end())
+        {
+            site = state.siteIds.emplace(in_record.callSite, uint32_t(state.siteIds.size())).first;
+            const uint32_t length = uint32_t(strlen(in_record.callSite->fileName));
+            state.WritePod(BinaryEntryType::Site);
+            state.WritePod(site->second);
+            state.WritePod(int32_t(in_record.callSite->line));
+            state.WritePod(int32_t(in_record.callSite->logLevel));
+            state.WritePod(length);
+            state.Write(in_record.callSite->fileName, length);
+        }
+
+        auto category = state.categoryIds.find(in_record.categoryName);
+        if (category == state.categoryIds.end())
+        {
+            category = state.categoryIds.emplace(in_record.categoryName, uint32_t(state.categoryIds.size())).first;
+            const uint32_t length = uint32_t(std::char_traits<TCHARTYPE>::length(in_record.categoryName));
+            state.WritePod(BinaryEntryType::Category);
+            state.WritePod(category->second);
+            state.WritePod(length);
+            state.Write(in_record.categoryName, length * sizeof(TCHARTYPE));
+        }
+
+        state.WritePod(BinaryEntryType::Record);
+        state.WritePod(site->second);
+        state.WritePod(category->second);
+        state.WritePod(in_record.timestamp);
+        // The thread context, if any, is stored as leading operands, so that it decodes before the message as in text mode.
+        const TSTRINGVIEW context = in_record.context ? in_record.context->GetArguments() : TSTRINGVIEW();
+        state.WritePod(uint32_t(context.size() + in_record.argumentsSize));
+        state.Write(context.data(), context.size() * sizeof(TCHARTYPE));
+        state.Write(in_record.arguments, in_record.argumentsSize * sizeof(TCHARTYPE));
+    }
+
+    void Flush() const noexcept
+    {
+        std::scoped_lock<std::mutex> lock(m_state->mutex);
+        fflush(m_state->file);
+    }
+
+private:
+    struct State
+    {
+        FILE* file = nullptr;
+        std::vector<char> buffer;
+        std::mutex mutex;
+        std::unordered_map<const CallSite*, uint32_t> siteIds;
+        std::unordered_map<const TCHARTYPE*, uint32_t> categoryIds;
+
+       ~State() { if (file) fclose(file); }
+        void Write(const void* in_data, const size_t in_size) noexcept { fwrite(in_data, 1, in_size, file); }
+        template<typename T> void WritePod(const T& in_value) noexcept { Write(&in_value, sizeof(T)); }
+    };
+
+    std::shared_ptr<State> m_state; // Shared, so that copies registered into the frontend write to the same file.
+};
+
+class BinaryFileReader final
+{
+public:
+    struct Record
+    {
+        const CallSite* callSite;
+        TSTRINGVIEW categoryName;
+        int64_t timestamp;
+        Writer message; // Decoded text, without the trailing new line.
+    };
+
+    explicit BinaryFileReader(const char* in_fileName)
+    {
+        m_file = fopen(in_fileName, "rb");
+        if (!m_file)
+            throw Exception();
+
+        char magic[sizeof(k_binaryFileMagic)];
+        uint32_t version = 0, charSize = 0, byteOrderMark = 0;
+        if (!Read(magic, sizeof(magic)) || (memcmp(magic, k_binaryFileMagic, sizeof(magic)) != 0) ||
+            !ReadPod(version) || (version != k_binaryFileVersion) ||
+            !ReadPod(charSize) || (charSize != sizeof(TCHARTYPE)) ||
+            !ReadPod(byteOrderMark) || (byteOrderMark != k_binaryFileByteOrderMark))
+        {
+            fclose(m_file);
+            throw Exception();
+        }
+    }
+
+   ~BinaryFileReader() { fclose(m_file); }
+    BinaryFileReader(const BinaryFileReader&) = delete;
+    BinaryFileReader& operator=(const BinaryFileReader&) = delete;
+
+    // Reads the next record. Returns false at the end of the file or if the file is malformed (see IsCorrupted).
+    bool ReadNext(Record& out_record) noexcept
+    {
+        BinaryEntryType type;
+        while (ReadPod(type))
+        {
+            switch (type)
+            {
+            case BinaryEntryType::Site:
+            {
+                uint32_t id = 0, length = 0;
+                int32_t line = 0, level = 0;
+                if (!ReadPod(id) || !ReadPod(line) || !ReadPod(level) || !ReadPod(length))
+                    return Fail();
+                auto& site = m_sites[id];
+                site.fileName.resize(length);
+                if (!Read(site.fileName.data(), length))
+                    return Fail();
+                site.callSite = { site.fileName.c_str(), line, level };
+                break;
+            }
+            case BinaryEntryType::Category:
+            {
+                uint32_t id = 0, length = 0;
+                if (!ReadPod(id) || !ReadPod(length))
+                    return Fail();
+                auto& category = m_categories[id];
+                category.resize(length);
+                if (!Read(category.data(), length * sizeof(TCHARTYPE)))
+                    return Fail();
+                break;
+            }
+            case BinaryEntryType::Record:
+            {
+                uint32_t siteId = 0, categoryId = 0, size = 0;
+                if (!ReadPod(siteId) || !ReadPod(categoryId) || !ReadPod(out_record.timestamp) || !ReadPod(size))
+                    return Fail();
+                m_arguments.resize(size);
+                if (!Read(m_arguments.data(), size * sizeof(TCHARTYPE)))
+                    return Fail();
+                const auto site     = m_sites     .find(siteId);
+                const auto category = m_categories.find(categoryId);
+                if ((site == m_sites.end()) || (category == m_categories.end()))
+                    return Fail();
+                out_record.callSite     = &site->second.callSite;
+                out_record.categoryName = category->second;
+                out_record.message.Clear();
+                if (!DecodeArguments(m_arguments.data(), m_arguments.size(), out_record.message))
+                    return Fail();
+                return true;
+            }
+            default:
+                return Fail();
+            }
+        }
+        return false;
+    }
+
+    bool IsCorrupted() const noexcept { return m_corrupted; }
+
+private:
+    struct Site
+    {
+        std::string fileName;
+        CallSite callSite;
+    };
+
+    FILE* m_file = nullptr;
+    bool m_corrupted = false;
+    std::unordered_map<uint32_t, Site> m_sites;
+    std::unordered_map<uint32_t, TSTRING> m_categories;
+    std::vector<TCHARTYPE> m_arguments;
+
+    bool Read(void* out_data, const size_t in_size) noexcept { return fread(out_data, 1, in_size, m_file) == in_size; }
+    template<typename T> bool ReadPod(T& out_value) noexcept { return Read(&out_value, sizeof(T)); }
+    bool Fail() noexcept { m_corrupted = true; return false; }
+};
+}// dlog.
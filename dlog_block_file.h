@@ -0,0 +1,674 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2023 David Caadas Mazo.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include "dlog.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <vector>
+
+// Block-compressed log files, written by BlockFileBackend (a batched backend) and queried by BlockFileReader (see
+// tools/dlog_query.cpp). Records are gathered into blocks that a background thread compresses and writes, so that
+// logging threads only copy them. Each block header describes its records (time range, highest level and a bloom
+// filter of their categories), so that readers skip the blocks that can't match a query without decompressing them.
+// Values are stored in host byte order.
+//
+// File header: magic "DLOGBLK", format version, sizeof(TCHARTYPE) and a byte order mark.
+// Then a sequence of blocks: a BlockHeader followed by its payload, compressed with BlockCodec (or stored as is, if
+// it doesn't compress). Once decompressed, a payload is a sequence of records: int64 timestamp, int32 level,
+// uint32 category name length, uint32 message length, category name and message (TCHARTYPE).
+// Blocks are written whole, so a crash can only truncate the last one.
+
+namespace dlog
+{
+static constexpr char     k_blockFileMagic[8]      = { 'D', 'L', 'O', 'G', 'B', 'L', 'K', 0 };
+static constexpr uint32_t k_blockFileVersion       = 1;
+static constexpr uint32_t k_blockFileByteOrderMark = 0x01020304;
+static constexpr uint32_t k_blockMagic             = 0x4B4C4244; // "DBLK".
+
+// Dependency-free LZ77 codec, in the spirit of LZ4: sequences of literals and (offset, length) back-references
+// into the last 64 KiB, found through a hash table of 4-byte prefixes. Favors speed over ratio.
+// Sequence: token (literal length and match length - 4, 4 bits each, 15 meaning that 255-terminated extra bytes
+// follow), literals, 16-bit offset, extra match length bytes. The last sequence only has literals.
+class BlockCodec final
+{
+public:
+    static constexpr size_t GetMaxCompressedSize(const size_t in_size) noexcept { return in_size + (in_size / 255) + 16; }
+
+    // out_data must have room for GetMaxCompressedSize(in_size) bytes. Returns the compressed size.
+    static size_t Compress(const uint8_t* in_data, const size_t in_size, uint8_t* out_data) noexcept
+    {
+        uint32_t table[k_hashSize] = { };
+        const uint8_t* in = in_data;
+        const uint8_t* end = in_data + in_size;
+        const uint8_t* literals = in_data;
+        uint8_t* out = out_data;
+        if (in_size > k_lastLiterals + k_minMatch)
+        {
+            const uint8_t* matchLimit = end - k_lastLiterals;
+            while (in < (matchLimit - k_minMatch))
+            {
+                const uint32_t sequence = Read32(in);
+                uint32_t& entry = table[Hash(sequence)];
+                const uint8_t* candidate = in_data + entry;
+                entry = uint32_t(in - in_data);
+                if ((candidate >= in) || ((in - candidate) > k_maxOffset) || (Read32(candidate) != sequence))
+                {
+                    in += 1 + ((in - literals) >> 6); // Skips faster through data that doesn't compress.
+                    continue;
+                }
+                size_t length = k_minMatch;
+                while (((in + length) < matchLimit) && (candidate[length] == in[length]))
+                    ++length;
+                out = WriteSequence(out, literals, size_t(in - literals), uint16_t(in - candidate), length);
+                in += length;
+                literals = in;
+            }
+        }
+        return size_t(WriteSequence(out, literals, size_t(end - literals), 0, 0) - out_data);
+    }
+
+    // Fails (returns false) unless in_data decompresses to exactly in_decompressedSize bytes.
+    static bool Decompress(const uint8_t* in_data, const size_t in_size, uint8_t* out_data, const size_t in_decompressedSize) noexcept
+    {
+        const uint8_t* in = in_data;
+        const uint8_t* inEnd = in_data + in_size;
+        uint8_t* out = out_data;
+        uint8_t* outEnd = out_data + in_decompressedSize;
+        while (in < inEnd)
+        {
+            const uint8_t token = *(in++);
+            size_t literalLength = token >> 4;
+            if ((literalLength == 15) && !ReadLength(in, inEnd, literalLength))
+                return false;
+            if ((size_t(inEnd - in) < literalLength) || (size_t(outEnd - out) < literalLength))
+                return false;
+            if (literalLength)
+                memcpy(out, in, literalLength);
+            in  += literalLength;
+            out += literalLength;
+            if (in == inEnd)
+                break; // Last sequence.
+
+            if ((inEnd - in) < 2)
+                return false;
+            const size_t offset = size_t(in[0]) | (size_t(in[1]) << 8);
+            in += 2;
+            size_t length = token & 15;
+            if ((length == 15) && !ReadLength(in, inEnd, length))
+                return false;
+            length += k_minMatch;
+            if ((offset == 0) || (offset > size_t(out - out_data)) || (size_t(outEnd - out) < length))
+                return false;
+            const uint8_t* match = out - offset;
+            if (offset >= length)
+                memcpy(out, match, length);
+            else for (size_t i = 0; i < length; ++i) // Overlaps the bytes it produces (runs).
+                out[i] = match[i];
+            out += length;
+        }
+        return out == outEnd;
+    }
+
+private:
+    static constexpr size_t    k_hashBits     = 14;
+    static constexpr size_t    k_hashSize     = size_t(1) << k_hashBits;
+    static constexpr size_t    k_minMatch     = 4;
+    static constexpr size_t    k_lastLiterals = 5;
+    static constexpr ptrdiff_t k_maxOffset    = 65535;
+
+    static uint32_t Read32(const uint8_t* in_data) noexcept { uint32_t value; memcpy(&value, in_data, sizeof(value)); return value; }
+    static uint32_t Hash(const uint32_t in_sequence) noexcept { return (in_sequence * 2654435761u) >> (32 - k_hashBits); }
+
+    static uint8_t* WriteLength(uint8_t* out_data, size_t in_length) noexcept
+    {
+        for (; in_length >= 255; in_length -= 255)
+            *(out_data++) = 255;
+        *(out_data++) = uint8_t(in_length);
+        return out_data;
+    }
+
+    static bool ReadLength(const uint8_t*& inout_data, const uint8_t* in_end, size_t& inout_length) noexcept
+    {
+        uint8_t byte = 255;
+        while (byte == 255)
+        {
+            if (inout_data == in_end)
+                return false;
+            byte = *(inout_data++);
+            inout_length += byte;
+        }
+        return true;
+    }
+
+    // in_matchLength == 0: last sequence, literals only.
+    static uint8_t* WriteSequence(uint8_t* out_data, const uint8_t* in_literals, const size_t in_literalLength, const uint16_t in_offset, const size_t in_matchLength) noexcept
+    {
+        uint8_t* token = out_data++;
+        *token = uint8_t(std::min<size_t>(in_literalLength, 15) << 4);
+        if (in_literalLength >= 15)
+            out_data = WriteLength(out_data, in_literalLength - 15);
+        if (in_literalLength)
+            memcpy(out_data, in_literals, in_literalLength);
+        out_data += in_literalLength;
+        if (in_matchLength == 0)
+            return out_data;
+        *(out_data++) = uint8_t(in_offset);
+        *(out_data++) = uint8_t(in_offset >> 8);
+        const size_t length = in_matchLength - k_minMatch;
+        *token |= uint8_t(std::min<size_t>(length, 15));
+        if (length >= 15)
+            out_data = WriteLength(out_data, length - 15);
+        return out_data;
+    }
+};
+
+// Bloom filter (256 bits, 3 hashes) of the category names of a block. Takes the values of Hash(), so that
+// callers can compute them once per category.
+struct BlockCategoryFilter
+{
+    uint64_t bits[4] = { };
+
+    static uint64_t Hash(const TSTRINGVIEW in_name) noexcept
+    {
+        uint64_t hash = HashText(in_name);
+        hash ^= hash >> 33;
+        hash *= 0xFF51AFD7ED558CCDull;
+        return hash ^ (hash >> 33);
+    }
+
+    void Add(const uint64_t in_hash) noexcept
+    {
+        for (int i = 0; i < 3; ++i)
+            bits[(in_hash >> (i * 8 + 6)) & 3] |= uint64_t(1) << ((in_hash >> (i * 8)) & 63);
+    }
+
+    bool MayContain(const uint64_t in_hash) const noexcept
+    {
+        for (int i = 0; i < 3; ++i)
+            if (!(bits[(in_hash >> (i * 8 + 6)) & 3] & (uint64_t(1) << ((in_hash >> (i * 8)) & 63))))
+                return false;
+        return true;
+    }
+};
+
+struct BlockHeader
+{
+    uint32_t magic = k_blockMagic;
+    uint32_t compressedSize = 0;   // Payload bytes in the file. Equal to uncompressedSize if stored as is.
+    uint32_t uncompressedSize = 0;
+    uint32_t recordCount = 0;
+    int64_t minTimestamp = INT64_MAX;
+    int64_t maxTimestamp = INT64_MIN;
+    int32_t maxLogLevel = INT32_MIN;
+    uint32_t reserved = 0;
+    BlockCategoryFilter categories;
+};
+
+struct BlockFileOptions
+{
+    std::string fileName;
+    size_t blockSize = 64 * 1024;   // Uncompressed bytes per block: larger blocks compress better, smaller ones are skipped more often.
+    size_t maxPendingBlocks = 8;    // Full blocks waiting for the background thread before logging threads have to wait.
+    std::chrono::milliseconds flushInterval = std::chrono::milliseconds(1000); // Partially filled blocks are written after this time.
+};
+
+// Batched backend (it needs the level and timestamp of each record):
+//     logger += DLog::BatchBackend { dlog::BlockFileBackend(options), { } };
+class BlockFileBackend final
+{
+public:
+    explicit BlockFileBackend(const BlockFileOptions& in_options) : m_state(std::make_shared<State>(in_options)) { ; }
+
+    void operator()(const Record* in_records, const size_t in_count) const noexcept { m_state->Write(in_records, in_count); }
+
+    // Blocks until every record received so far has been compressed and handed to the operating system.
+    void Flush() const noexcept { m_state->Flush(); }
+
+private:
+    static constexpr size_t k_recordHeaderSize = sizeof(int64_t) + (3 * sizeof(uint32_t));
+
+    struct Block
+    {
+        BlockHeader header;
+        std::vector<char> payload; // Uncompressed.
+    };
+
+    class State final
+    {
+    public:
+        explicit State(const BlockFileOptions& in_options) : m_options(in_options)
+        {
+            m_options.blockSize        = std::max<size_t>(m_options.blockSize, 4096);
+            m_options.maxPendingBlocks = std::max<size_t>(m_options.maxPendingBlocks, 1);
+#if defined(_MSC_VER)
+#           pragma warning(push)
+#           pragma warning(disable: 4996) // This function or variable may be unsafe. Consider using fopen_s instead.
+#endif//defined(_MSC_VER)
+            m_file = fopen(m_options.fileName.c_str(), "wb");
+#if defined(_MSC_VER)
+#           pragma warning(pop)
+#endif//defined(_MSC_VER)
+            if (!m_file)
+                throw Exception();
+            const uint32_t header[3] = { k_blockFileVersion, uint32_t(sizeof(TCHARTYPE)), k_blockFileByteOrderMark };
+            fwrite(k_blockFileMagic, 1, sizeof(k_blockFileMagic), m_file);
+            fwrite(header, 1, sizeof(header), m_file);
+            m_active.payload.reserve(m_options.blockSize);
+            m_thread = std::thread([this]() { Run(); });
+            LiveStates::Get().Add(this);
+        }
+
+       ~State()
+        {
+            LiveStates::Get().Remove(this);
+            Close();
+        }
+
+        void Write(const Record* in_records, const size_t in_count) noexcept
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            for (size_t i = 0; (i < in_count) && !m_stop; ++i)
+            {
+                const Record& record = in_records[i];
+                if (record.categoryName != m_lastCategoryName) // Category names are interned: hashed once per run of records.
+                {
+                    m_lastCategoryName = record.categoryName;
+                    m_lastCategory     = record.categoryName ? TSTRINGVIEW(record.categoryName) : TSTRINGVIEW();
+                    m_lastCategoryHash = BlockCategoryFilter::Hash(m_lastCategory);
+                }
+                const TSTRINGVIEW category = m_lastCategory;
+                const size_t size = k_recordHeaderSize + ((category.size() + record.message.size()) * sizeof(TCHARTYPE));
+                if (!m_active.payload.empty() && ((m_active.payload.size() + size) > m_options.blockSize))
+                {
+                    Seal(lock, true);
+                    if (m_stop)
+                        return; // Closed while waiting.
+                }
+
+                BlockHeader& header = m_active.header;
+                header.minTimestamp = std::min(header.minTimestamp, record.timestamp);
+                header.maxTimestamp = std::max(header.maxTimestamp, record.timestamp);
+                header.maxLogLevel  = std::max(header.maxLogLevel, int32_t(record.logLevel));
+                header.categories.Add(m_lastCategoryHash);
+                ++header.recordCount;
+
+                const uint32_t lengths[3] = { uint32_t(record.logLevel), uint32_t(category.size()), uint32_t(record.message.size()) };
+                const size_t offset = m_active.payload.size();
+                m_active.payload.resize(offset + size);
+                char* out = m_active.payload.data() + offset;
+                memcpy(out, &record.timestamp, sizeof(int64_t));
+                memcpy(out + sizeof(int64_t), lengths, sizeof(lengths));
+                memcpy(out + k_recordHeaderSize, category.data(), category.size() * sizeof(TCHARTYPE));
+                memcpy(out + k_recordHeaderSize + (category.size() * sizeof(TCHARTYPE)), record.message.data(), record.message.size() * sizeof(TCHARTYPE));
+            }
+        }
+
+        void Flush() noexcept
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_stop)
+                return;
+            if (!m_active.payload.empty())
+                Seal(lock, false);
+            const uint64_t target = m_takenBlocks + m_pending.size();
+            m_wakeUp.notify_all();
+            m_done.wait(lock, [&]() { return m_closed || (m_writtenBlocks >= target); });
+        }
+
+        // Writes everything and closes the file. Also run at exit, so that DFATAL does not lose records.
+        void Close() noexcept
+        {
+            {
+                std::scoped_lock<std::mutex> lock(m_mutex);
+                if (m_stop)
+                    return;
+                m_stop = true;
+                m_wakeUp.notify_all();
+                m_done.notify_all();
+            }
+            m_thread.join();
+
+            std::scoped_lock<std::mutex> lock(m_mutex);
+            if (!m_active.payload.empty())
+                m_pending.push_back(std::move(m_active));
+            for (Block& it : m_pending)
+                WriteBlock(it);
+            m_pending.clear();
+            fclose(m_file);
+            m_closed = true;
+            m_done.notify_all();
+        }
+
+    private:
+        BlockFileOptions m_options;
+        std::mutex m_mutex;
+        std::condition_variable m_wakeUp;  // Wakes the background thread up.
+        std::condition_variable m_done;    // Signaled by the background thread when a block has been written.
+        std::thread m_thread;
+        bool m_stop = false;
+        bool m_closed = false;
+
+        FILE* m_file = nullptr;
+        Block m_active;
+        std::deque<Block> m_pending;       // Full blocks waiting to be written, in order.
+        std::vector<std::vector<char>> m_freePayloads;
+        uint64_t m_takenBlocks = 0;        // Blocks taken from m_pending by the background thread.
+        uint64_t m_writtenBlocks = 0;
+        std::vector<uint8_t> m_compressed; // Only used by the thread writing blocks.
+        const TCHARTYPE* m_lastCategoryName = nullptr;
+        TSTRINGVIEW m_lastCategory;
+        uint64_t m_lastCategoryHash = BlockCategoryFilter::Hash(TSTRINGVIEW());
+
+        // Queues the active block. Waits only when the background thread can't keep up (unless in_wait is false).
+        void Seal(std::unique_lock<std::mutex>& inout_lock, const bool in_wait) noexcept
+        {
+            if (in_wait && (m_pending.size() >= m_options.maxPendingBlocks))
+            {
+                m_wakeUp.notify_one();
+                m_done.wait(inout_lock, [&]() { return m_stop || (m_pending.size() < m_options.maxPendingBlocks); });
+            }
+            Block block;
+            if (!m_freePayloads.empty())
+            {
+                block.payload = std::move(m_freePayloads.back());
+                m_freePayloads.pop_back();
+            }
+            else
+                block.payload.reserve(m_options.blockSize);
+            m_pending.push_back(std::exchange(m_active, std::move(block)));
+            m_wakeUp.notify_one();
+        }
+
+        void WriteBlock(Block& inout_block) noexcept
+        {
+            BlockHeader& header = inout_block.header;
+            const uint8_t* payload = (const uint8_t*)inout_block.payload.data();
+            header.uncompressedSize = uint32_t(inout_block.payload.size());
+            m_compressed.resize(BlockCodec::GetMaxCompressedSize(inout_block.payload.size()));
+            header.compressedSize = uint32_t(BlockCodec::Compress(payload, inout_block.payload.size(), m_compressed.data()));
+            if (header.compressedSize < header.uncompressedSize)
+                payload = m_compressed.data();
+            else
+                header.compressedSize = header.uncompressedSize; // Stored as is.
+            fwrite(&header, 1, sizeof(header), m_file);
+            fwrite(payload, 1, header.compressedSize, m_file);
+        }
+
+        // Background thread. It is the only one compressing and writing blocks, until closed.
+        void Run() noexcept
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (!m_stop)
+            {
+                const bool woken = m_wakeUp.wait_for(lock, m_options.flushInterval, [&]() { return m_stop || !m_pending.empty(); });
+                if (!woken && !m_active.payload.empty())
+                    Seal(lock, false); // Idle: writes whatever is buffered.
+                while (!m_pending.empty() && !m_stop)
+                {
+                    Block block = std::move(m_pending.front());
+                    m_pending.pop_front();
+                    ++m_takenBlocks;
+                    const bool last = m_pending.empty();
+                    lock.unlock();
+                    WriteBlock(block);
+                    if (last)
+                        fflush(m_file);
+                    lock.lock();
+
+                    block.payload.clear();
+                    if (m_freePayloads.size() < m_options.maxPendingBlocks)
+                        m_freePayloads.push_back(std::move(block.payload));
+                    ++m_writtenBlocks;
+                    m_done.notify_all();
+                }
+            }
+        }
+
+        // Live backends, closed when the program exits (DFATAL calls exit(), so destructors may never run).
+        // Intentionally leaked, so that backends destroyed later on can still unregister.
+        struct LiveStates final
+        {
+            std::mutex mutex;
+            std::vector<State*> states;
+
+            static LiveStates& Get() noexcept
+            {
+                static LiveStates* s_liveStates = []()
+                {
+                    std::atexit([]()
+                    {
+                        std::vector<State*> states;
+                        {
+                            std::scoped_lock<std::mutex> lock(Get().mutex);
+                            states = Get().states;
+                        }
+                        for (State* it : states)
+                            it->Close();
+                    });
+                    return new LiveStates();
+                }();
+                return *s_liveStates;
+            }
+
+            void Add(State* in_state) noexcept
+            {
+                std::scoped_lock<std::mutex> lock(mutex);
+                states.push_back(in_state);
+            }
+
+            void Remove(State* in_state) noexcept
+            {
+                std::scoped_lock<std::mutex> lock(mutex);
+                states.erase(std::find(states.begin(), states.end(), in_state));
+            }
+        };
+    };
+
+    std::shared_ptr<State> m_state; // Shared, so that the copies registered into the frontend write to the same file.
+};
+
+// Records a BlockFileReader returns. Blocks are skipped, undecompressed, when their header shows that none of
+// their records can match.
+struct BlockQuery
+{
+    int64_t fromTimestamp = INT64_MIN;  // Inclusive, in nanoseconds since the system_clock epoch.
+    int64_t toTimestamp   = INT64_MAX;  // Inclusive.
+    int minLogLevel = INT_MIN;
+    std::vector<TSTRING> categories;    // Any of them (all if empty).
+    TSTRING text;                       // Contained in the message (any if empty).
+};
+
+class BlockFileReader final
+{
+public:
+    struct Record
+    {
+        int64_t timestamp;
+        int logLevel;
+        TSTRINGVIEW categoryName; // Views into the current block, valid until the next call to ReadNext.
+        TSTRINGVIEW message;      // Formatted message, including the trailing new line.
+    };
+
+    struct Statistics
+    {
+        uint64_t blocks = 0;
+        uint64_t skippedBlocks = 0;
+        uint64_t records = 0;           // In the blocks that were read.
+        uint64_t matchedRecords = 0;
+        uint64_t compressedBytes = 0;   // Payload bytes of the blocks that were read, as stored...
+        uint64_t uncompressedBytes = 0; // ...and once decompressed.
+    };
+
+    explicit BlockFileReader(const char* in_fileName, const BlockQuery& in_query = BlockQuery()) : m_query(in_query)
+    {
+        for (const TSTRING& it : m_query.categories)
+            m_categoryHashes.push_back(BlockCategoryFilter::Hash(it));
+#if defined(_MSC_VER)
+#       pragma warning(push)
+#       pragma warning(disable: 4996) // This function or variable may be unsafe. Consider using fopen_s instead.
+#endif//defined(_MSC_VER)
+        m_file = fopen(in_fileName, "rb");
+#if defined(_MSC_VER)
+#       pragma warning(pop)
+#endif//defined(_MSC_VER)
+        if (!m_file)
+            throw Exception();
+
+        char magic[sizeof(k_blockFileMagic)];
+        uint32_t header[3] = { };
+        if ((fread(magic, 1, sizeof(magic), m_file) != sizeof(magic)) || (memcmp(magic, k_blockFileMagic, sizeof(magic)) != 0) ||
+            (fread(header, 1, sizeof(header), m_file) != sizeof(header)) ||
+            (header[0] != k_blockFileVersion) || (header[1] != sizeof(TCHARTYPE)) || (header[2] != k_blockFileByteOrderMark))
+        {
+            fclose(m_file);
+            throw Exception();
+        }
+    }
+
+   ~BlockFileReader() { fclose(m_file); }
+    BlockFileReader(const BlockFileReader&) = delete;
+    BlockFileReader& operator=(const BlockFileReader&) = delete;
+
+    // Reads the next matching record. Returns false at the end of the file or if the file is malformed (see IsCorrupted).
+    bool ReadNext(Record& out_record) noexcept
+    {
+        for (;;)
+        {
+            while (m_cursor < m_payload.size())
+            {
+                if (!ReadRecord(out_record))
+                    return Fail();
+                ++m_statistics.records;
+                if (Matches(out_record))
+                {
+                    ++m_statistics.matchedRecords;
+                    return true;
+                }
+            }
+            if (!ReadBlock())
+                return false;
+        }
+    }
+
+    bool IsCorrupted() const noexcept { return m_corrupted; }
+    const Statistics& GetStatistics() const noexcept { return m_statistics; }
+
+private:
+    FILE* m_file = nullptr;
+    BlockQuery m_query;
+    std::vector<uint64_t> m_categoryHashes;
+    Statistics m_statistics;
+    bool m_corrupted = false;
+    std::vector<uint8_t> m_compressed;
+    std::vector<uint8_t> m_payload; // Decompressed block.
+    size_t m_cursor = 0;            // Into m_payload.
+    std::vector<TCHARTYPE> m_strings; // Category name and message of the current record, aligned (wide characters only).
+
+    bool Fail() noexcept { m_corrupted = true; return false; }
+
+    bool MayMatch(const BlockHeader& in_header) const noexcept
+    {
+        if ((in_header.maxTimestamp < m_query.fromTimestamp) || (in_header.minTimestamp > m_query.toTimestamp) || (in_header.maxLogLevel < m_query.minLogLevel))
+            return false;
+        return m_categoryHashes.empty() || std::any_of(m_categoryHashes.begin(), m_categoryHashes.end(), [&in_header](const uint64_t in_hash) { return in_header.categories.MayContain(in_hash); });
+    }
+
+    bool Matches(const Record& in_record) const noexcept
+    {
+        return (in_record.timestamp >= m_query.fromTimestamp) && (in_record.timestamp <= m_query.toTimestamp) && (in_record.logLevel >= m_query.minLogLevel) &&
+               (m_query.categories.empty() || (std::find(m_query.categories.begin(), m_query.categories.end(), in_record.categoryName) != m_query.categories.end())) &&
+               (m_query.text.empty() || (in_record.message.find(m_query.text) != TSTRINGVIEW::npos));
+    }
+
+    // Reads block headers until one may match, and decompresses it. Returns false at the end of the file.
+    bool ReadBlock() noexcept
+    {
+        m_payload.clear();
+        m_cursor = 0;
+        BlockHeader header;
+        while (fread(&header, 1, sizeof(header), m_file) == sizeof(header))
+        {
+            if ((header.magic != k_blockMagic) || (header.compressedSize > header.uncompressedSize))
+                return Fail();
+            ++m_statistics.blocks;
+            if (!MayMatch(header))
+            {
+                ++m_statistics.skippedBlocks;
+                if (fseek(m_file, long(header.compressedSize), SEEK_CUR) != 0)
+                    return Fail();
+                continue;
+            }
+
+            m_payload.resize(header.uncompressedSize);
+            if (header.compressedSize == header.uncompressedSize)
+            {
+                if (fread(m_payload.data(), 1, m_payload.size(), m_file) != m_payload.size())
+                    return Fail();
+            }
+            else
+            {
+                m_compressed.resize(header.compressedSize);
+                if ((fread(m_compressed.data(), 1, m_compressed.size(), m_file) != m_compressed.size()) ||
+                    !BlockCodec::Decompress(m_compressed.data(), m_compressed.size(), m_payload.data(), m_payload.size()))
+                    return Fail();
+            }
+            m_statistics.compressedBytes   += header.compressedSize;
+            m_statistics.uncompressedBytes += header.uncompressedSize;
+            return true;
+        }
+        return false;
+    }
+
+    bool ReadRecord(Record& out_record) noexcept
+    {
+        uint32_t lengths[3];
+        constexpr size_t k_headerSize = sizeof(int64_t) + sizeof(lengths);
+        if ((m_payload.size() - m_cursor) < k_headerSize)
+            return false;
+        memcpy(&out_record.timestamp, m_payload.data() + m_cursor, sizeof(int64_t));
+        memcpy(lengths, m_payload.data() + m_cursor + sizeof(int64_t), sizeof(lengths));
+        m_cursor += k_headerSize;
+        const size_t length = size_t(lengths[1]) + lengths[2];
+        if (((m_payload.size() - m_cursor) / sizeof(TCHARTYPE)) < length)
+            return false;
+        const TCHARTYPE* text = (const TCHARTYPE*)(m_payload.data() + m_cursor);
+        if constexpr (alignof(TCHARTYPE) > 1) // Records are not aligned on character boundaries in the payload.
+        {
+            m_strings.resize(length);
+            memcpy(m_strings.data(), text, length * sizeof(TCHARTYPE));
+            text = m_strings.data();
+        }
+        m_cursor += length * sizeof(TCHARTYPE);
+        out_record.logLevel     = int(int32_t(lengths[0]));
+        out_record.categoryName = TSTRINGVIEW(text, lengths[1]);
+        out_record.message      = TSTRINGVIEW(text + lengths[1], lengths[2]);
+        return true;
+    }
+};
+}// dlog.
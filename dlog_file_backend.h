@@ -0,0 +1,604 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2023 David Caadas Mazo.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "dlog.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <deque>
+#include <string>
+#include <utility>
+
+#if defined(_WIN32)
+#   ifndef NOMINMAX
+#   define NOMINMAX
+#   endif//NOMINMAX
+#   include <windows.h>
+#else
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <unistd.h>
+#endif//defined(_WIN32)
+
+// High-throughput file backend. Messages are copied into large write-combining buffers that a background thread
+// writes to disk, so logging threads never wait for I/O or file rotation (only for a free buffer if the disk can't
+// keep up). In memory-mapped mode, messages are copied straight into a mapping of the pre-extended file instead.
+//
+// FileBackend is a cheap handle; register it either as a per-message or as a batched backend:
+//     logger += dlog::FileBackend(options);
+//     logger += DLog::BatchBackend { dlog::FileBackend(options), { } };
+
+namespace dlog
+{
+struct FileOptions
+{
+    std::string fileName;
+    size_t bufferSize  = 1 << 20;   // Size of each write-combining buffer.
+    size_t bufferCount = 4;         // Buffers that can be filled while the background thread writes.
+    std::chrono::milliseconds flushInterval = std::chrono::milliseconds(1000); // Partially filled buffers are written after this time.
+
+    uint64_t maxFileSize = 0;       // Rotate once the file reaches this size (0: never).
+    std::chrono::seconds maxFileAge = std::chrono::seconds(0); // Rotate once the file is this old (0: never).
+    size_t maxRotatedFiles = 0;     // Rotated files to keep, older ones are deleted (0: keep all).
+
+    bool memoryMapped  = false;
+    size_t mappingSize = 64 << 20;  // Memory-mapped mode: size of each mapped window (rounded up to 1 MiB).
+};
+
+// Minimal memory-mapped file wrapper. The file grows one window at a time and is truncated to its actual
+// length when closed.
+class MappedFile final
+{
+public:
+    struct View
+    {
+        char* data = nullptr;
+        size_t size = 0;
+#if defined(_WIN32)
+        HANDLE mapping = nullptr;
+#endif//defined(_WIN32)
+    };
+
+    bool Open(const char* in_fileName) noexcept
+    {
+#if defined(_WIN32)
+        m_file = CreateFileA(in_fileName, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        return m_file != INVALID_HANDLE_VALUE;
+#else
+        m_file = open(in_fileName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        return m_file >= 0;
+#endif//defined(_WIN32)
+    }
+
+    // Maps [in_offset, in_offset + in_size), extending the file if needed.
+    View Map(const uint64_t in_offset, const size_t in_size) noexcept
+    {
+        View view;
+#if defined(_WIN32)
+        const uint64_t end = in_offset + in_size;
+        view.mapping = CreateFileMappingA(m_file, nullptr, PAGE_READWRITE, DWORD(end >> 32), DWORD(end), nullptr);
+        if (!view.mapping)
+            return View();
+        view.data = (char*)MapViewOfFile(view.mapping, FILE_MAP_WRITE, DWORD(in_offset >> 32), DWORD(in_offset), in_size);
+        if (!view.data)
+        {
+            CloseHandle(view.mapping);
+            return View();
+        }
+#else
+        if (ftruncate(m_file, off_t(in_offset + in_size)) != 0)
+            return View();
+        void* data = mmap(nullptr, in_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_file, off_t(in_offset));
+        if (data == MAP_FAILED)
+            return View();
+        view.data = (char*)data;
+#endif//defined(_WIN32)
+        view.size = in_size;
+        return view;
+    }
+
+    static void Unmap(View& inout_view) noexcept
+    {
+        if (!inout_view.data)
+            return;
+#if defined(_WIN32)
+        UnmapViewOfFile(inout_view.data);
+        CloseHandle(inout_view.mapping);
+#else
+        munmap(inout_view.data, inout_view.size);
+#endif//defined(_WIN32)
+        inout_view = View();
+    }
+
+    // Every view must have been unmapped before.
+    void Close(const uint64_t in_length) noexcept
+    {
+#if defined(_WIN32)
+        if (m_file == INVALID_HANDLE_VALUE)
+            return;
+        LARGE_INTEGER length;
+        length.QuadPart = LONGLONG(in_length);
+        SetFilePointerEx(m_file, length, nullptr, FILE_BEGIN);
+        SetEndOfFile(m_file);
+        CloseHandle(m_file);
+        m_file = INVALID_HANDLE_VALUE;
+#else
+        if (m_file < 0)
+            return;
+        if (ftruncate(m_file, off_t(in_length)) != 0) { ; }
+        close(m_file);
+        m_file = -1;
+#endif//defined(_WIN32)
+    }
+
+private:
+#if defined(_WIN32)
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+#else
+    int m_file = -1;
+#endif//defined(_WIN32)
+};
+
+class FileBackend final
+{
+public:
+    explicit FileBackend(const FileOptions& in_options) : m_state(std::make_shared<State>(in_options)) { ; }
+
+    void operator()(const TCHARTYPE* in_message, const TCHARTYPE*) const noexcept 
+    { 
+        const size_t length = std::char_traits<TCHARTYPE>::length(in_message);
+        m_state->Write(&in_message, &length, 1);
+    }
+
+    void operator()(const Record* in_records, const size_t in_count) const noexcept
+    {
+        // Copied in chunks, so that a single lock covers many records.
+        const TCHARTYPE* messages[64];
+        size_t lengths[64];
+        for (size_t i = 0; i < in_count; )
+        {
+            size_t count = 0;
+            for (; (count < 64) && (i < in_count); ++count, ++i)
+            {
+                messages[count] = in_records[i].message.data();
+                lengths [count] = in_records[i].message.size();
+            }
+            m_state->Write(messages, lengths, count);
+        }
+    }
+
+    // Blocks until everything written so far has been handed to the operating system.
+    void Flush() const noexcept { m_state->Flush(); }
+
+private:
+    class State final
+    {
+    public:
+        explicit State(const FileOptions& in_options) : m_options(in_options)
+        {
+            m_options.bufferSize  = std::max<size_t>(m_options.bufferSize, 4096);
+            m_options.bufferCount = std::max<size_t>(m_options.bufferCount, 2);
+            m_options.mappingSize = ((std::max<size_t>(m_options.mappingSize, 1) + (1 << 20) - 1) >> 20) << 20;
+            if (!OpenFile(m_options.fileName, m_file, m_mappedFile, m_view))
+                throw Exception();
+            m_fileOpenedAt = std::chrono::steady_clock::now();
+            if (!m_options.memoryMapped)
+            {
+                for (size_t i = 0; i < m_options.bufferCount; ++i)
+                    m_freeBuffers.push_back(MakeBuffer());
+                m_active = TakeFreeBuffer();
+            }
+            m_thread = std::thread([this]() { Run(); });
+            LiveStates::Get().Add(this);
+        }
+
+       ~State()
+        {
+            LiveStates::Get().Remove(this);
+            Close();
+        }
+
+        void Write(const TCHARTYPE* const* in_messages, const size_t* in_lengths, const size_t in_count) noexcept
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            for (size_t i = 0; (i < in_count) && !m_closed; ++i)
+            {
+                const char* data = (const char*)in_messages[i];
+                const size_t size = in_lengths[i] * sizeof(TCHARTYPE);
+                if (m_options.memoryMapped)
+                    WriteMapped(lock, data, size);
+                else
+                    WriteBuffered(lock, data, size);
+            }
+        }
+
+        void Flush() noexcept
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_closed || m_options.memoryMapped)
+                return; // Copies into the mapping are visible to the operating system right away.
+            if (!m_active.empty())
+                m_pending.push_back(std::exchange(m_active, TakeFreeBuffer()));
+            const uint64_t target = m_takenBuffers + m_pending.size();
+            m_wakeUp.notify_all();
+            m_done.wait(lock, [&]() { return m_closed || (m_writtenBuffers >= target); });
+        }
+
+        // Writes everything and closes the file. Also run at exit, so that DFATAL does not lose messages.
+        void Close() noexcept
+        {
+            {
+                std::scoped_lock<std::mutex> lock(m_mutex);
+                if (m_stop)
+                    return;
+                m_stop = true;
+                m_wakeUp.notify_all();
+            }
+            m_thread.join();
+
+            std::scoped_lock<std::mutex> lock(m_mutex);
+            if (!m_active.empty())
+                m_pending.push_back(std::move(m_active));
+            for (const TBUFFER& it : m_pending)
+            {
+                if (m_file)
+                    fwrite(it.data(), 1, it.size(), m_file);
+            }
+            m_pending.clear();
+            CloseFile(m_file, m_mappedFile, m_view, m_nextView, m_fileSize);
+            m_closed = true;
+            m_done.notify_all();
+        }
+
+    private:
+        using TBUFFER = std::vector<char>;
+
+        FileOptions m_options;
+        std::mutex m_mutex;
+        std::condition_variable m_wakeUp;   // Wakes the background thread up.
+        std::condition_variable m_done;     // Signaled by the background thread when a buffer or a view is available.
+        std::thread m_thread;
+        bool m_stop = false;
+        bool m_closed = false;
+
+        FILE* m_file = nullptr;             // Buffered mode.
+        TBUFFER m_active;
+        std::vector<TBUFFER> m_freeBuffers;
+        std::deque<TBUFFER> m_pending;      // Full buffers waiting to be written, in order.
+        uint64_t m_takenBuffers = 0;        // Buffers taken from m_pending by the background thread.
+        uint64_t m_writtenBuffers = 0;
+
+        MappedFile m_mappedFile;            // Memory-mapped mode.
+        MappedFile::View m_view;
+        MappedFile::View m_nextView;        // Mapped by the background thread before m_view fills up.
+        uint64_t m_viewOffset = 0;
+        size_t m_viewUsed = 0;
+        bool m_mappingFailed = false;
+
+        uint64_t m_fileSize = 0;            // Bytes written to the current file.
+        std::chrono::steady_clock::time_point m_fileOpenedAt;
+        std::chrono::steady_clock::time_point m_rotationRetryAt; // After a failed rotation.
+        static constexpr std::chrono::seconds k_rotationRetryDelay = std::chrono::seconds(1);
+        std::deque<std::string> m_rotatedFiles;
+
+        TBUFFER MakeBuffer() const noexcept
+        {
+            TBUFFER buffer;
+            buffer.reserve(m_options.bufferSize);
+            return buffer;
+        }
+
+        TBUFFER TakeFreeBuffer() noexcept
+        {
+            if (m_freeBuffers.empty())
+                return MakeBuffer();
+            TBUFFER buffer = std::move(m_freeBuffers.back());
+            m_freeBuffers.pop_back();
+            return buffer;
+        }
+
+        void WriteBuffered(std::unique_lock<std::mutex>& inout_lock, const char* in_data, const size_t in_size) noexcept
+        {
+            if (in_size > m_options.bufferSize)
+            {
+                // Oversized message: queued on its own, right after whatever is buffered.
+                if (!m_active.empty())
+                    m_pending.push_back(std::exchange(m_active, TakeFreeBuffer()));
+                m_pending.emplace_back(in_data, in_data + in_size);
+                m_wakeUp.notify_one();
+                return;
+            }
+            if ((m_active.size() + in_size) > m_options.bufferSize)
+            {
+                // Waits only when the disk can't keep up. Other producers may swap the buffer meanwhile.
+                m_wakeUp.notify_one();
+                m_done.wait(inout_lock, [&]() { return m_stop || !m_freeBuffers.empty() || ((m_active.size() + in_size) <= m_options.bufferSize); });
+                if ((m_active.size() + in_size) > m_options.bufferSize)
+                {
+                    m_pending.push_back(std::exchange(m_active, TakeFreeBuffer()));
+                    m_wakeUp.notify_one();
+                }
+            }
+            m_active.insert(m_active.end(), in_data, in_data + in_size);
+        }
+
+        void WriteMapped(std::unique_lock<std::mutex>& inout_lock, const char* in_data, size_t in_size) noexcept
+        {
+            while (in_size)
+            {
+                if (m_viewUsed == m_view.size)
+                {
+                    // Only the background thread maps views, so that the file never shrinks under a mapping.
+                    m_wakeUp.notify_one();
+                    m_done.wait(inout_lock, [&]() { return m_stop || m_mappingFailed || m_nextView.data || (m_viewUsed < m_view.size); });
+                    if (m_viewUsed < m_view.size)
+                        continue; // Rotated meanwhile.
+                    if (!m_nextView.data)
+                        return;
+                    MappedFile::Unmap(m_view);
+                    m_view = std::exchange(m_nextView, MappedFile::View());
+                    m_viewOffset += m_options.mappingSize;
+                    m_viewUsed = 0;
+                    m_wakeUp.notify_one();
+                }
+                const size_t count = std::min(in_size, m_view.size - m_viewUsed);
+                memcpy(m_view.data + m_viewUsed, in_data, count);
+                m_viewUsed += count;
+                m_fileSize += count;
+                in_data    += count;
+                in_size    -= count;
+            }
+        }
+
+        bool OpenFile(const std::string& in_fileName, FILE*& out_file, MappedFile& out_mappedFile, MappedFile::View& out_view, const bool in_append = false) const noexcept
+        {
+            if (!m_options.memoryMapped)
+            {
+#if defined(_MSC_VER)
+#               pragma warning(push)
+#               pragma warning(disable: 4996) // This function or variable may be unsafe. Consider using fopen_s instead.
+#endif//defined(_MSC_VER)
+                out_file = fopen(in_fileName.c_str(), in_append ? "ab" : "wb");
+#if defined(_MSC_VER)
+#               pragma warning(pop)
+#endif//defined(_MSC_VER)
+                if (out_file)
+                    setvbuf(out_file, nullptr, _IONBF, 0); // Writes are already combined.
+                return out_file != nullptr;
+            }
+            if (!out_mappedFile.Open(in_fileName.c_str()))
+                return false;
+            out_view = out_mappedFile.Map(0, m_options.mappingSize);
+            return out_view.data != nullptr;
+        }
+
+        static void CloseFile(FILE*& inout_file, MappedFile& inout_mappedFile, MappedFile::View& inout_view, MappedFile::View& inout_nextView, const uint64_t in_length) noexcept
+        {
+            if (inout_file)
+            {
+                fclose(inout_file);
+                inout_file = nullptr;
+            }
+            MappedFile::Unmap(inout_view);
+            MappedFile::Unmap(inout_nextView);
+            inout_mappedFile.Close(in_length);
+        }
+
+        // Also true when a failed rotation left no file open (buffered mode), once it is time to try again.
+        bool ShouldRotate() const noexcept
+        {
+            const auto now = std::chrono::steady_clock::now();
+            if (now < m_rotationRetryAt)
+                return false;
+            if (!m_options.memoryMapped && !m_file)
+                return true;
+            return (m_fileSize > 0) &&
+                   (((m_options.maxFileSize > 0) && (m_fileSize >= m_options.maxFileSize)) ||
+                    ((m_options.maxFileAge.count() > 0) && ((now - m_fileOpenedAt) >= m_options.maxFileAge)));
+        }
+
+        // Rotated files are named after the active one, plus the rotation date and a sequence number.
+        static std::string MakeRotatedFileName(const std::string& in_fileName) noexcept
+        {
+            static std::atomic<uint32_t> s_sequence = 0;
+            const std::time_t now = std::time(nullptr);
+            char date[32] = "";
+#if defined(_MSC_VER)
+#           pragma warning(push)
+#           pragma warning(disable: 4996) // This function or variable may be unsafe. Consider using localtime_s instead.
+#endif//defined(_MSC_VER)
+            if (const std::tm* localTime = std::localtime(&now))
+                std::strftime(date, sizeof(date), "%Y%m%d-%H%M%S", localTime);
+#if defined(_MSC_VER)
+#           pragma warning(pop)
+#endif//defined(_MSC_VER)
+            return in_fileName + '.' + date + '.' + std::to_string(s_sequence++);
+        }
+
+        // Runs on the background thread with the lock released, so producers never wait for the file system.
+        void Rotate(std::unique_lock<std::mutex>& inout_lock) noexcept
+        {
+            std::string rotatedFileName = MakeRotatedFileName(m_options.fileName);
+            if (!m_options.memoryMapped)
+            {
+                // The file is only used by the background thread: producers keep on filling buffers meanwhile.
+                // On failure, the active file is kept (or reopened) and rotation is tried again later on.
+                MappedFile mappedFile;
+                MappedFile::View view;
+                const auto retryLater = [&]()
+                {
+                    if (!m_file)
+                        OpenFile(m_options.fileName, m_file, mappedFile, view, true);
+                    m_rotationRetryAt = std::chrono::steady_clock::now() + k_rotationRetryDelay;
+                };
+                if (!m_file)
+                    return retryLater(); // A previous attempt could not reopen the file.
+                fclose(m_file);
+                m_file = nullptr;
+                if (std::rename(m_options.fileName.c_str(), rotatedFileName.c_str()) != 0)
+                    return retryLater();
+                if (!OpenFile(m_options.fileName, m_file, mappedFile, view))
+                {
+                    std::rename(rotatedFileName.c_str(), m_options.fileName.c_str());
+                    return retryLater();
+                }
+                m_fileSize = 0;
+            }
+            else
+            {
+                // Producers copy into the mapping: the next file is mapped before, and only pointers are swapped under the lock.
+                const std::string nextFileName = m_options.fileName + ".next";
+                FILE* file = nullptr;
+                MappedFile mappedFile;
+                MappedFile::View view, nextView;
+                if (!OpenFile(nextFileName, file, mappedFile, view))
+                {
+                    m_rotationRetryAt = std::chrono::steady_clock::now() + k_rotationRetryDelay;
+                    return;
+                }
+
+                inout_lock.lock();
+                std::swap(mappedFile, m_mappedFile);
+                std::swap(view, m_view);
+                std::swap(nextView, m_nextView);
+                const uint64_t length = std::exchange(m_fileSize, 0);
+                m_viewOffset = 0;
+                m_viewUsed = 0;
+                m_mappingFailed = false;
+                m_done.notify_all();
+                inout_lock.unlock();
+
+                CloseFile(file, mappedFile, view, nextView, length);
+                std::rename(m_options.fileName.c_str(), rotatedFileName.c_str());
+                std::rename(nextFileName.c_str(), m_options.fileName.c_str());
+            }
+            m_fileOpenedAt = std::chrono::steady_clock::now();
+            m_rotatedFiles.push_back(std::move(rotatedFileName));
+            while ((m_options.maxRotatedFiles > 0) && (m_rotatedFiles.size() > m_options.maxRotatedFiles))
+            {
+                std::remove(m_rotatedFiles.front().c_str());
+                m_rotatedFiles.pop_front();
+            }
+        }
+
+        // Background thread. It is the only one writing to, mapping, or swapping the file.
+        void Run() noexcept
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (!m_stop)
+            {
+                const bool woken = m_wakeUp.wait_for(lock, m_options.flushInterval, [&]()
+                {
+                    return m_stop || !m_pending.empty() || (m_options.memoryMapped && !m_nextView.data && !m_mappingFailed) || ShouldRotate();
+                });
+
+                if (!m_options.memoryMapped)
+                {
+                    if (!woken && !m_active.empty())
+                        m_pending.push_back(std::exchange(m_active, TakeFreeBuffer())); // Idle: write whatever is buffered.
+                    while (!m_pending.empty())
+                    {
+                        TBUFFER buffer = std::move(m_pending.front());
+                        m_pending.pop_front();
+                        ++m_takenBuffers;
+                        lock.unlock();
+                        const size_t written = m_file ? fwrite(buffer.data(), 1, buffer.size(), m_file) : 0;
+                        lock.lock();
+
+                        m_fileSize += written;
+                        buffer.clear();
+                        if ((buffer.capacity() >= m_options.bufferSize) && (m_freeBuffers.size() < m_options.bufferCount))
+                            m_freeBuffers.push_back(std::move(buffer));
+                        ++m_writtenBuffers;
+                        m_done.notify_all();
+                    }
+                }
+                else
+                {
+                    if (!m_nextView.data && !m_mappingFailed)
+                    {
+                        const uint64_t offset = m_viewOffset + m_options.mappingSize;
+                        lock.unlock();
+                        MappedFile::View view = m_mappedFile.Map(offset, m_options.mappingSize);
+                        lock.lock();
+                        m_nextView = view;
+                        m_mappingFailed = !view.data;
+                        m_done.notify_all();
+                    }
+                }
+                if (ShouldRotate())
+                {
+                    lock.unlock();
+                    Rotate(lock);
+                    lock.lock();
+                }
+            }
+        }
+
+        // Live backends, closed when the program exits (DFATAL calls exit(), so destructors may never run).
+        // Intentionally leaked, so that backends destroyed later on can still unregister.
+        struct LiveStates final
+        {
+            std::mutex mutex;
+            std::vector<State*> states;
+
+            static LiveStates& Get() noexcept
+            {
+                static LiveStates* s_liveStates = []()
+                {
+                    std::atexit([]()
+                    {
+                        std::vector<State*> states;
+                        {
+                            std::scoped_lock<std::mutex> lock(Get().mutex);
+                            states = Get().states;
+                        }
+                        for (State* it : states)
+                            it->Close();
+                    });
+                    return new LiveStates();
+                }();
+                return *s_liveStates;
+            }
+
+            void Add(State* in_state) noexcept
+            {
+                std::scoped_lock<std::mutex> lock(mutex);
+                states.push_back(in_state);
+            }
+
+            void Remove(State* in_state) noexcept
+            {
+                std::scoped_lock<std::mutex> lock(mutex);
+                states.erase(std::find(states.begin(), states.end(), in_state));
+            }
+        };
+    };
+
+    std::shared_ptr<State> m_state; // Shared, so that the copies registered into the frontend write to the same file.
+};
+}// dlog.
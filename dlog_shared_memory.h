@@ -0,0 +1,604 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2023 David Caadas Mazo.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include "dlog.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <new>
+#include <string>
+#include <thread>
+#include <utility>
+
+#if defined(_WIN32)
+#   ifndef NOMINMAX
+#   define NOMINMAX
+#   endif//NOMINMAX
+#   include <windows.h>
+#else
+#   include <cerrno>
+#   include <fcntl.h>
+#   include <signal.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif//defined(_WIN32)
+
+// Shared-memory transport, for hosts running many processes that log: each process hands its messages to a ring
+// buffer in a named shared memory segment, and a single collector (SharedMemoryCollector, see tools/dlog_collect.cpp)
+// drains the rings of all processes into one stream, ordered by timestamp.
+//
+// Every SharedMemoryBackend (text) or SharedMemoryBinaryBackend (binary capture mode) attaches to a ring of its own.
+// Rings are bounded multi-producer queues of fixed-size slots: threads reserve a slot with a compare-and-swap on the
+// ring's enqueue position and publish it through the slot's sequence number, so logging never takes a lock, and
+// messages are dropped (and counted) rather than blocking when the collector can't keep up. A process that crashes
+// can only leave slots of its own ring unpublished: once the collector finds it dead, it drains what was published,
+// skips the rest and hands the ring to the next process.
+//
+// Segment: SharedMemoryHeader, then ringCount rings. Ring: SharedRingHeader, then slotCount slots of slotSize bytes.
+// Slot: SharedSlotHeader, then a SharedRecordHeader followed by the category name (TCHARTYPE), the file name (char)
+// and the message (TCHARTYPE: formatted text, or the encoded arguments of a binary record). Values are stored in host
+// byte order; producers and the collector must be built with the same TCHARTYPE.
+
+namespace dlog
+{
+struct SharedMemoryOptions
+{
+    std::string name = "dlog";  // Name of the segment, shared by producers and the collector.
+    // Geometry, only used by the process that creates the segment (the others use the existing one):
+    uint32_t ringCount = 64;    // Backends that can be attached at once, over all processes.
+    uint32_t slotCount = 4096;  // Slots per ring, rounded up to a power of two.
+    uint32_t slotSize  = 512;   // Bytes per slot, headers included. Longer messages are truncated.
+    std::chrono::milliseconds openTimeout = std::chrono::milliseconds(1000); // Time to wait for another process to initialize the segment.
+};
+
+static constexpr uint32_t k_sharedMemoryMagic   = 0x474F4C44; // "DLOG".
+static constexpr uint32_t k_sharedMemoryVersion = 2;
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free, "The shared-memory transport needs address-free (lock-free) atomics.");
+
+struct SharedMemoryHeader
+{
+    std::atomic<uint32_t> magic; // Set once the segment is initialized.
+    uint32_t version;
+    uint32_t charSize;
+    uint32_t ringCount;
+    uint32_t slotCount;
+    uint32_t slotSize;
+    uint64_t ringSize;           // In bytes, header and slots.
+};
+
+struct alignas(64) SharedRingHeader
+{
+    enum State : uint32_t { Free, Attached, Detached, Reclaiming };
+
+    std::atomic<uint64_t> owner;   // State in the low 32 bits, process id of the producer in the high ones.
+    std::atomic<uint64_t> dropped; // Messages dropped because the ring was full.
+    alignas(64) std::atomic<uint64_t> enqueuePosition;
+    alignas(64) std::atomic<uint64_t> dequeuePosition; // Only written by the collector.
+
+    static constexpr uint64_t MakeOwner(const State in_state, const uint32_t in_processId) noexcept { return (uint64_t(in_processId) << 32) | in_state; }
+    static constexpr State GetState(const uint64_t in_owner) noexcept { return State(uint32_t(in_owner)); }
+    static constexpr uint32_t GetProcessId(const uint64_t in_owner) noexcept { return uint32_t(in_owner >> 32); }
+};
+
+struct SharedSlotHeader
+{
+    std::atomic<uint64_t> sequence; // Position + 1 once published, position + slotCount once consumed.
+    uint32_t size;                  // Of the record, in bytes.
+    uint32_t reserved;
+};
+
+enum class SharedRecordKind : uint8_t
+{
+    Formatted, // Text from a text backend, formatted by the producer.
+    Arguments, // Encoded arguments of a binary record.
+    Message,   // Arguments that didn't fit, decoded (and truncated) by the producer.
+};
+
+struct SharedRecordHeader
+{
+    int64_t timestamp;       // Nanoseconds since the system_clock epoch.
+    int32_t logLevel;        // 0 for formatted records.
+    int32_t line;
+    uint32_t categoryLength; // In characters.
+    uint32_t fileNameLength;
+    uint32_t messageLength;
+    SharedRecordKind kind;
+    uint8_t truncated;
+    uint8_t reserved[2];
+};
+
+// Named shared memory segment, created by whichever process opens it first.
+class SharedMemorySegment final
+{
+public:
+    explicit SharedMemorySegment(const SharedMemoryOptions& in_options)
+    {
+        SharedMemoryOptions options = in_options;
+        options.slotCount = std::max<uint32_t>(options.slotCount, 2);
+        while ((options.slotCount & (options.slotCount - 1)) != 0)
+            options.slotCount += options.slotCount & (0u - options.slotCount); // Rounds up to a power of two.
+        options.slotSize  = std::max<uint32_t>((options.slotSize + 7) & ~7u, uint32_t(sizeof(SharedSlotHeader) + sizeof(SharedRecordHeader) + 64));
+        options.ringCount = std::max<uint32_t>(options.ringCount, 1);
+        const uint64_t ringSize = sizeof(SharedRingHeader) + (uint64_t(options.slotCount) * options.slotSize);
+        const uint64_t size = RoundUp(sizeof(SharedMemoryHeader)) + (options.ringCount * ringSize);
+
+        if (!Map(options.name, size))
+        {
+            Unmap();
+            throw Exception();
+        }
+        if (m_created)
+            Initialize(options, ringSize);
+        else if (!WaitForInitialization(options.openTimeout))
+        {
+            Unmap();
+            throw Exception();
+        }
+    }
+
+   ~SharedMemorySegment() { Unmap(); }
+    SharedMemorySegment(const SharedMemorySegment&) = delete;
+    SharedMemorySegment& operator=(const SharedMemorySegment&) = delete;
+
+    const SharedMemoryHeader& GetHeader() const noexcept { return *reinterpret_cast<const SharedMemoryHeader*>(m_data); }
+    uint32_t GetRingCount() const noexcept { return GetHeader().ringCount; }
+    SharedRingHeader& GetRing(const uint32_t in_ring) const noexcept { return *reinterpret_cast<SharedRingHeader*>(m_data + RoundUp(sizeof(SharedMemoryHeader)) + (in_ring * GetHeader().ringSize)); }
+    SharedSlotHeader& GetSlot(const SharedRingHeader& in_ring, const uint64_t in_position) const noexcept
+    {
+        const SharedMemoryHeader& header = GetHeader();
+        return *reinterpret_cast<SharedSlotHeader*>((char*)&in_ring + sizeof(SharedRingHeader) + ((in_position & (header.slotCount - 1)) * header.slotSize));
+    }
+    size_t GetRecordCapacity() const noexcept { return GetHeader().slotSize - sizeof(SharedSlotHeader); }
+
+    static uint32_t GetProcessId() noexcept
+    {
+#if defined(_WIN32)
+        return uint32_t(GetCurrentProcessId());
+#else
+        return uint32_t(getpid());
+#endif//defined(_WIN32)
+    }
+
+    static bool IsProcessAlive(const uint32_t in_processId) noexcept
+    {
+#if defined(_WIN32)
+        const HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, DWORD(in_processId));
+        if (!process)
+            return GetLastError() == ERROR_ACCESS_DENIED;
+        const bool alive = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+        CloseHandle(process);
+        return alive;
+#else
+        return (kill(pid_t(in_processId), 0) == 0) || (errno == EPERM);
+#endif//defined(_WIN32)
+    }
+
+    // Removes the segment name, once no process needs it any longer (processes that have it open keep using it).
+    // Windows removes segments along with the last process that has them open.
+    static void Remove(const std::string& in_name) noexcept
+    {
+#if !defined(_WIN32)
+        shm_unlink(("/" + in_name).c_str());
+#else
+        (void)in_name;
+#endif//!defined(_WIN32)
+    }
+
+private:
+    char* m_data = nullptr;
+    uint64_t m_size = 0;
+    bool m_created = false;
+#if defined(_WIN32)
+    HANDLE m_mapping = nullptr;
+#endif//defined(_WIN32)
+
+    static constexpr uint64_t RoundUp(const uint64_t in_size) noexcept { return (in_size + 63) & ~uint64_t(63); }
+
+    bool Map(const std::string& in_name, const uint64_t in_size) noexcept
+    {
+#if defined(_WIN32)
+        m_mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, DWORD(in_size >> 32), DWORD(in_size), ("Local\\" + in_name).c_str());
+        if (!m_mapping)
+            return false;
+        m_created = GetLastError() != ERROR_ALREADY_EXISTS;
+        m_data = (char*)MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+        MEMORY_BASIC_INFORMATION region = { };
+        if (m_data && VirtualQuery(m_data, &region, sizeof(region)))
+            m_size = region.RegionSize; // The existing segment may not have the requested size.
+        return m_data != nullptr;
+#else
+        const std::string name = "/" + in_name;
+        int file = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        m_created = file >= 0;
+        if (m_created)
+        {
+            if (ftruncate(file, off_t(in_size)) != 0)
+            {
+                close(file);
+                shm_unlink(name.c_str());
+                return false;
+            }
+            m_size = in_size;
+        }
+        else
+        {
+            file = shm_open(name.c_str(), O_RDWR, 0600);
+            if (file < 0)
+                return false;
+            // The creator sizes the segment right after creating it.
+            struct stat status = { };
+            for (int i = 0; (fstat(file, &status) == 0) && (status.st_size == 0) && (i < 1000); ++i)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            m_size = uint64_t(status.st_size);
+        }
+        void* data = (m_size >= sizeof(SharedMemoryHeader)) ? mmap(nullptr, size_t(m_size), PROT_READ | PROT_WRITE, MAP_SHARED, file, 0) : MAP_FAILED;
+        close(file);
+        m_data = (data != MAP_FAILED) ? (char*)data : nullptr;
+        return m_data != nullptr;
+#endif//defined(_WIN32)
+    }
+
+    void Unmap() noexcept
+    {
+#if defined(_WIN32)
+        if (m_data)
+            UnmapViewOfFile(m_data);
+        if (m_mapping)
+            CloseHandle(m_mapping);
+        m_mapping = nullptr;
+#else
+        if (m_data)
+            munmap(m_data, size_t(m_size));
+#endif//defined(_WIN32)
+        m_data = nullptr;
+    }
+
+    void Initialize(const SharedMemoryOptions& in_options, const uint64_t in_ringSize) noexcept
+    {
+        SharedMemoryHeader& header = *new (m_data) SharedMemoryHeader { { 0 }, k_sharedMemoryVersion, uint32_t(sizeof(TCHARTYPE)), in_options.ringCount, in_options.slotCount, in_options.slotSize, in_ringSize };
+        for (uint32_t i = 0; i < header.ringCount; ++i)
+        {
+            SharedRingHeader& ring = *new (&GetRing(i)) SharedRingHeader { { 0 }, { 0 }, { 0 }, { 0 } };
+            for (uint64_t position = 0; position < header.slotCount; ++position)
+                new (&GetSlot(ring, position)) SharedSlotHeader { { position }, 0, 0 };
+        }
+        header.magic.store(k_sharedMemoryMagic, std::memory_order_release);
+    }
+
+    bool WaitForInitialization(const std::chrono::milliseconds in_timeout) const noexcept
+    {
+        const auto deadline = std::chrono::steady_clock::now() + in_timeout;
+        const SharedMemoryHeader& header = GetHeader();
+        while (header.magic.load(std::memory_order_acquire) != k_sharedMemoryMagic)
+        {
+            if (std::chrono::steady_clock::now() > deadline)
+                return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        const uint64_t ringsEnd = RoundUp(sizeof(SharedMemoryHeader)) + (header.ringCount * header.ringSize);
+        return (header.version == k_sharedMemoryVersion) && (header.charSize == sizeof(TCHARTYPE)) && (ringsEnd <= m_size) && 
+               (header.slotCount != 0) && ((header.slotCount & (header.slotCount - 1)) == 0) && 
+               (header.slotSize >= (sizeof(SharedSlotHeader) + sizeof(SharedRecordHeader))) &&
+               (header.ringSize == (sizeof(SharedRingHeader) + (uint64_t(header.slotCount) * header.slotSize)));
+    }
+};
+
+// Producer side: owns one ring of the segment, detached (and left to the collector to drain) when destroyed.
+class SharedMemoryProducer final
+{
+public:
+    explicit SharedMemoryProducer(const SharedMemoryOptions& in_options)
+        : m_segment(in_options)
+    {
+        const uint64_t owner = SharedRingHeader::MakeOwner(SharedRingHeader::Attached, SharedMemorySegment::GetProcessId());
+        for (uint32_t i = 0; (i < m_segment.GetRingCount()) && !m_ring; ++i)
+        {
+            uint64_t expected = SharedRingHeader::MakeOwner(SharedRingHeader::Free, 0);
+            if (m_segment.GetRing(i).owner.compare_exchange_strong(expected, owner, std::memory_order_acquire))
+                m_ring = &m_segment.GetRing(i);
+        }
+        if (!m_ring)
+            throw Exception(); // Every ring is taken.
+    }
+
+   ~SharedMemoryProducer()
+    {
+        m_ring->owner.store(SharedRingHeader::MakeOwner(SharedRingHeader::Detached, SharedMemorySegment::GetProcessId()), std::memory_order_release);
+    }
+
+    SharedMemoryProducer(const SharedMemoryProducer&) = delete;
+    SharedMemoryProducer& operator=(const SharedMemoryProducer&) = delete;
+
+    void Write(const SharedRecordKind in_kind, const int64_t in_timestamp, const int in_logLevel, const CallSite* in_optCallSite, const TCHARTYPE* in_categoryName, const TCHARTYPE* in_message, const size_t in_messageLength) noexcept
+    {
+        const TSTRINGVIEW category = in_categoryName ? TSTRINGVIEW(in_categoryName) : TSTRINGVIEW();
+        const char* fileName = in_optCallSite ? in_optCallSite->fileName : "";
+        const size_t capacity = m_segment.GetRecordCapacity() - sizeof(SharedRecordHeader);
+
+        SharedRecordHeader header = { };
+        header.timestamp      = in_timestamp;
+        header.logLevel       = in_logLevel;
+        header.line           = in_optCallSite ? in_optCallSite->line : 0;
+        header.kind           = in_kind;
+        header.categoryLength = uint32_t(std::min(category.size(), capacity / (2 * sizeof(TCHARTYPE))));
+        header.fileNameLength = uint32_t(std::min(strlen(fileName), (capacity / 2) - (header.categoryLength * sizeof(TCHARTYPE))));
+        const size_t room     = (capacity - (header.categoryLength * sizeof(TCHARTYPE)) - header.fileNameLength) / sizeof(TCHARTYPE);
+        if ((in_messageLength > room) && (in_kind == SharedRecordKind::Arguments))
+        {
+            // Encoded arguments can't be cut anywhere: they are decoded here instead, and truncated as text.
+            thread_local Writer t_message;
+            t_message.Clear();
+            DecodeArguments(in_message, in_messageLength, t_message);
+            Write(SharedRecordKind::Message, in_timestamp, in_logLevel, in_optCallSite, in_categoryName, t_message.Data(), t_message.Size());
+            return;
+        }
+        header.messageLength  = uint32_t(std::min(in_messageLength, room));
+        header.truncated      = header.messageLength < in_messageLength;
+
+        SharedRingHeader& ring = *m_ring;
+        uint64_t position = ring.enqueuePosition.load(std::memory_order_relaxed);
+        SharedSlotHeader* slot = nullptr;
+        for (;;)
+        {
+            slot = &m_segment.GetSlot(ring, position);
+            const int64_t difference = int64_t(slot->sequence.load(std::memory_order_acquire) - position);
+            if (difference == 0)
+            {
+                if (ring.enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (difference < 0)
+            {
+                ring.dropped.fetch_add(1, std::memory_order_relaxed); // Full.
+                return;
+            }
+            else
+                position = ring.enqueuePosition.load(std::memory_order_relaxed);
+        }
+
+        char* out = reinterpret_cast<char*>(slot + 1);
+        memcpy(out, &header, sizeof(header));
+        out += sizeof(header);
+        memcpy(out, category.data(), header.categoryLength * sizeof(TCHARTYPE));
+        out += header.categoryLength * sizeof(TCHARTYPE);
+        memcpy(out, fileName, header.fileNameLength);
+        out += header.fileNameLength;
+        memcpy(out, in_message, header.messageLength * sizeof(TCHARTYPE));
+        out += header.messageLength * sizeof(TCHARTYPE);
+        slot->size = uint32_t(out - reinterpret_cast<char*>(slot + 1));
+        slot->sequence.store(position + 1, std::memory_order_release);
+    }
+
+    uint64_t GetDroppedCount() const noexcept { return m_ring->dropped.load(std::memory_order_relaxed); }
+
+private:
+    SharedMemorySegment m_segment;
+    SharedRingHeader* m_ring = nullptr;
+};
+
+// Text backend: logger += dlog::SharedMemoryBackend(options). Records are timestamped when handed to the backend.
+class SharedMemoryBackend final
+{
+public:
+    explicit SharedMemoryBackend(const SharedMemoryOptions& in_options) : m_producer(std::make_shared<SharedMemoryProducer>(in_options)) { }
+
+    void operator()(const TCHARTYPE* in_message, const TCHARTYPE* in_categoryName) const noexcept
+    {
+        m_producer->Write(SharedRecordKind::Formatted, Now(), 0, nullptr, in_categoryName, in_message, std::char_traits<TCHARTYPE>::length(in_message));
+    }
+
+    uint64_t GetDroppedCount() const noexcept { return m_producer->GetDroppedCount(); }
+
+private:
+    std::shared_ptr<SharedMemoryProducer> m_producer; // Shared, so that copies registered into the frontend use the same ring.
+};
+
+// Binary backend (Frontend::captureMode = CaptureMode::Binary): arguments are decoded by the collector.
+class SharedMemoryBinaryBackend final
+{
+public:
+    explicit SharedMemoryBinaryBackend(const SharedMemoryOptions& in_options) : m_producer(std::make_shared<SharedMemoryProducer>(in_options)) { }
+
+    void operator()(const BinaryRecord& in_record) const noexcept
+    {
+        if (!in_record.context)
+        {
+            m_producer->Write(SharedRecordKind::Arguments, in_record.timestamp, in_record.callSite->logLevel, in_record.callSite, in_record.categoryName, in_record.arguments, in_record.argumentsSize);
+            return;
+        }
+        // The thread context is sent as leading operands, so that it decodes before the message as in text mode.
+        thread_local Writer t_arguments;
+        t_arguments.Clear();
+        t_arguments.Append(in_record.context->GetArguments());
+        t_arguments.Append(in_record.arguments, in_record.argumentsSize);
+        m_producer->Write(SharedRecordKind::Arguments, in_record.timestamp, in_record.callSite->logLevel, in_record.callSite, in_record.categoryName, t_arguments.Data(), t_arguments.Size());
+    }
+
+    uint64_t GetDroppedCount() const noexcept { return m_producer->GetDroppedCount(); }
+
+private:
+    std::shared_ptr<SharedMemoryProducer> m_producer;
+};
+
+// Consumer side. There must be a single collector per segment at a time; its position in each ring lives in the
+// segment, so that a restarted collector carries on where the previous one stopped.
+class SharedMemoryCollector final
+{
+public:
+    struct Record
+    {
+        uint32_t processId;
+        int64_t timestamp;
+        int logLevel;        // 0 for formatted records.
+        TSTRING categoryName;
+        std::string fileName;
+        int line;
+        bool isFormatted;    // Text formatted by the producer, new line included.
+        bool isTruncated;
+        TSTRING message;
+    };
+
+    explicit SharedMemoryCollector(const SharedMemoryOptions& in_options) : m_segment(in_options) { }
+
+    // Drains every record published so far, sorts them by timestamp and passes them to in_function(const Record&).
+    // Records are only sorted within a poll: one published late may be older than those of the previous poll.
+    // Rings of processes that have exited (or crashed) are drained, then freed. Returns the number of records.
+    template<typename TFUNCTION>
+    size_t Poll(TFUNCTION&& in_function)
+    {
+        m_count = 0;
+        for (uint32_t i = 0; i < m_segment.GetRingCount(); ++i)
+        {
+            SharedRingHeader& ring = m_segment.GetRing(i);
+            const uint64_t owner = ring.owner.load(std::memory_order_acquire);
+            const SharedRingHeader::State state = SharedRingHeader::GetState(owner);
+            if ((state != SharedRingHeader::Attached) && (state != SharedRingHeader::Detached))
+                continue;
+            if (Drain(ring, false))
+                continue;
+            if ((state == SharedRingHeader::Attached) && SharedMemorySegment::IsProcessAlive(SharedRingHeader::GetProcessId(owner)))
+                continue;
+            // Detached, or its process is gone: whatever was published is drained, slots reserved but never
+            // published are skipped, and the ring is reset for the next producer.
+            Drain(ring, true);
+            Reclaim(ring);
+        }
+
+        std::stable_sort(m_order.begin(), m_order.begin() + m_count, [this](const size_t in_left, const size_t in_right) { return m_records[in_left].timestamp < m_records[in_right].timestamp; });
+        for (size_t i = 0; i < m_count; ++i)
+            in_function(std::as_const(m_records[m_order[i]]));
+        return m_count;
+    }
+
+    // Messages dropped by producers because their ring was full, over all rings.
+    uint64_t GetDroppedCount() const noexcept
+    {
+        uint64_t dropped = m_reclaimedDropped;
+        for (uint32_t i = 0; i < m_segment.GetRingCount(); ++i)
+            dropped += m_segment.GetRing(i).dropped.load(std::memory_order_relaxed);
+        return dropped;
+    }
+
+    // Slots reserved by producers that died before publishing them.
+    uint64_t GetLostCount() const noexcept { return m_lost; }
+
+private:
+    SharedMemorySegment m_segment;
+    std::vector<Record> m_records; // Reused from one poll to the next, to keep their buffers.
+    std::vector<size_t> m_order;
+    size_t m_count = 0;
+    uint64_t m_reclaimedDropped = 0;
+    uint64_t m_lost = 0;
+    std::vector<TCHARTYPE> m_arguments;
+    Writer m_decoded;
+
+    // Reads published slots from the dequeue position on. Unless in_skipUnpublished, stops at the first slot that
+    // isn't published yet. Returns whether anything was read.
+    bool Drain(SharedRingHeader& inout_ring, const bool in_skipUnpublished)
+    {
+        const uint64_t slotCount = m_segment.GetHeader().slotCount;
+        const uint64_t end = in_skipUnpublished ? inout_ring.enqueuePosition.load(std::memory_order_acquire) : UINT64_MAX;
+        const uint32_t processId = SharedRingHeader::GetProcessId(inout_ring.owner.load(std::memory_order_relaxed));
+        uint64_t position = inout_ring.dequeuePosition.load(std::memory_order_relaxed);
+        const uint64_t start = position;
+        for (; position < end; ++position)
+        {
+            SharedSlotHeader& slot = m_segment.GetSlot(inout_ring, position);
+            if (slot.sequence.load(std::memory_order_acquire) != (position + 1))
+            {
+                if (!in_skipUnpublished)
+                    break;
+                ++m_lost;
+                continue;
+            }
+            Read(slot, processId);
+            slot.sequence.store(position + slotCount, std::memory_order_release);
+            inout_ring.dequeuePosition.store(position + 1, std::memory_order_relaxed);
+        }
+        return position != start;
+    }
+
+    void Read(const SharedSlotHeader& in_slot, const uint32_t in_processId)
+    {
+        SharedRecordHeader header;
+        const char* in = reinterpret_cast<const char*>(&in_slot + 1);
+        if ((in_slot.size < sizeof(header)) || (in_slot.size > m_segment.GetRecordCapacity()))
+            return;
+        memcpy(&header, in, sizeof(header));
+        const size_t size = sizeof(header) + ((size_t(header.categoryLength) + header.messageLength) * sizeof(TCHARTYPE)) + header.fileNameLength;
+        if (size != in_slot.size)
+            return; // Malformed.
+        in += sizeof(header);
+
+        if (m_count == m_records.size())
+        {
+            m_records.emplace_back();
+            m_order.push_back(0);
+        }
+        Record& record = m_records[m_count];
+        record.processId   = in_processId;
+        record.timestamp   = header.timestamp;
+        record.logLevel    = header.logLevel;
+        record.line        = header.line;
+        record.isFormatted = header.kind == SharedRecordKind::Formatted;
+        record.isTruncated = header.truncated != 0;
+        record.categoryName.resize(header.categoryLength);
+        memcpy(record.categoryName.data(), in, header.categoryLength * sizeof(TCHARTYPE));
+        in += header.categoryLength * sizeof(TCHARTYPE);
+        record.fileName.assign(in, header.fileNameLength);
+        in += header.fileNameLength;
+        if (header.kind == SharedRecordKind::Arguments)
+        {
+            m_decoded.Clear();
+            m_arguments.resize(header.messageLength);
+            memcpy(m_arguments.data(), in, header.messageLength * sizeof(TCHARTYPE));
+            if (!DecodeArguments(m_arguments.data(), m_arguments.size(), m_decoded))
+                return;
+            record.message.assign(m_decoded.Data(), m_decoded.Size());
+        }
+        else
+        {
+            record.message.resize(header.messageLength);
+            memcpy(record.message.data(), in, header.messageLength * sizeof(TCHARTYPE));
+        }
+        m_order[m_count] = m_count;
+        ++m_count;
+    }
+
+    void Reclaim(SharedRingHeader& inout_ring) noexcept
+    {
+        inout_ring.owner.store(SharedRingHeader::MakeOwner(SharedRingHeader::Reclaiming, 0), std::memory_order_relaxed);
+        const uint64_t slotCount = m_segment.GetHeader().slotCount;
+        for (uint64_t position = 0; position < slotCount; ++position)
+            m_segment.GetSlot(inout_ring, position).sequence.store(position, std::memory_order_relaxed);
+        m_reclaimedDropped += inout_ring.dropped.exchange(0, std::memory_order_relaxed);
+        inout_ring.enqueuePosition.store(0, std::memory_order_relaxed);
+        inout_ring.dequeuePosition.store(0, std::memory_order_relaxed);
+        inout_ring.owner.store(SharedRingHeader::MakeOwner(SharedRingHeader::Free, 0), std::memory_order_release);
+    }
+};
+}// dlog.
@@ -0,0 +1,302 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2023 David Caadas Mazo.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "dlog.h"
+
+#include <cmath>
+
+#if defined(__AVX2__)
+#   include <immintrin.h>
+#   define DLOG_STRUCTURED_AVX2
+#endif//defined(__AVX2__)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#   include <emmintrin.h>
+#   define DLOG_STRUCTURED_SSE2
+#endif//defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#if defined(_MSC_VER)
+#   include <intrin.h>
+#endif//defined(_MSC_VER)
+
+// Structured encoders: binary backends (see CaptureMode::Binary) that render each record as a JSON object or as a
+// logfmt line, with the fields added through dlog::kv as members, and hand it to a text backend:
+//
+//   logger.captureMode = dlog::CaptureMode::Binary;
+//   logger += dlog::StructuredEncoder(dlog::StructuredFormat::Json, [](const char* in_line, const char*) { fputs(in_line, stdout); });
+//
+//   {"time":"2023-05-01T10:00:00.000Z","level":"INF","category":"default","msg":"Request served.","latency_us":42}
+//   time=2023-05-01T10:00:00.000Z level=INF category=default msg="Request served." latency_us=42
+//
+// Strings are escaped 16 (SSE2) or 32 (AVX2) characters at a time when single-byte characters are used.
+
+namespace dlog
+{
+inline uint32_t CountTrailingZeros(const uint32_t in_value) noexcept
+{
+#if defined(_MSC_VER)
+    unsigned long index = 0;
+    _BitScanForward(&index, in_value);
+    return uint32_t(index);
+#else
+    return uint32_t(__builtin_ctz(in_value));
+#endif//defined(_MSC_VER)
+}
+
+// Characters that JSON strings must escape ('"', '\\' and control characters). logfmt values must also be quoted
+// when they contain spaces or '='.
+template<bool NLOGFMT>
+inline bool IsSpecialChar(const TCHARTYPE in_char) noexcept
+{
+    const auto value = std::make_unsigned_t<TCHARTYPE>(in_char);
+    return (value < (NLOGFMT ? 0x21u : 0x20u)) || (value == '"') || (value == '\\') || (NLOGFMT && (value == '='));
+}
+
+// Returns the offset of the first special character (see IsSpecialChar) of the given text, or in_size if none.
+template<bool NLOGFMT>
+inline size_t FindSpecialChar(const TCHARTYPE* in_text, const size_t in_size) noexcept
+{
+    size_t offset = 0;
+    if constexpr (sizeof(TCHARTYPE) == 1)
+    {
+        // Characters up to the limit are found as those equal to max(c, limit), in unsigned arithmetic.
+#if defined(DLOG_STRUCTURED_AVX2)
+        {
+            const __m256i quote     = _mm256_set1_epi8('"');
+            const __m256i backslash = _mm256_set1_epi8('\\');
+            const __m256i equal     = _mm256_set1_epi8('=');
+            const __m256i limit     = _mm256_set1_epi8(NLOGFMT ? 0x20 : 0x1F);
+            for (; (offset + 32) <= in_size; offset += 32)
+            {
+                const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in_text + offset));
+                __m256i special = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote), _mm256_cmpeq_epi8(chunk, backslash));
+                special = _mm256_or_si256(special, _mm256_cmpeq_epi8(_mm256_max_epu8(chunk, limit), limit));
+                if constexpr (NLOGFMT)
+                    special = _mm256_or_si256(special, _mm256_cmpeq_epi8(chunk, equal));
+                if (const uint32_t mask = uint32_t(_mm256_movemask_epi8(special)))
+                    return offset + CountTrailingZeros(mask);
+            }
+        }
+#endif//defined(DLOG_STRUCTURED_AVX2)
+#if defined(DLOG_STRUCTURED_SSE2)
+        {
+            const __m128i quote     = _mm_set1_epi8('"');
+            const __m128i backslash = _mm_set1_epi8('\\');
+            const __m128i equal     = _mm_set1_epi8('=');
+            const __m128i limit     = _mm_set1_epi8(NLOGFMT ? 0x20 : 0x1F);
+            for (; (offset + 16) <= in_size; offset += 16)
+            {
+                const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in_text + offset));
+                __m128i special = _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash));
+                special = _mm_or_si128(special, _mm_cmpeq_epi8(_mm_max_epu8(chunk, limit), limit));
+                if constexpr (NLOGFMT)
+                    special = _mm_or_si128(special, _mm_cmpeq_epi8(chunk, equal));
+                if (const uint32_t mask = uint32_t(_mm_movemask_epi8(special)))
+                    return offset + CountTrailingZeros(mask);
+            }
+        }
+#endif//defined(DLOG_STRUCTURED_SSE2)
+    }
+    for (; offset < in_size; ++offset)
+        if (IsSpecialChar<NLOGFMT>(in_text[offset]))
+            return offset;
+    return in_size;
+}
+
+// Appends the given text escaped as the contents of a JSON string. Runs of plain characters are copied at once.
+inline void AppendJsonString(Writer& inout_writer, TSTRINGVIEW in_text) noexcept
+{
+    TCHARTYPE escaped[6] = { };
+    for (;;)
+    {
+        const size_t plain = FindSpecialChar<false>(in_text.data(), in_text.size());
+        inout_writer.Append(in_text.data(), plain);
+        if (plain == in_text.size())
+            break;
+        inout_writer.Append(escaped, EscapeJsonChar(in_text[plain], escaped));
+        in_text.remove_prefix(plain + 1);
+    }
+}
+
+// Appends the given text as a logfmt value: as is, unless it's empty or has special characters (then quoted).
+inline void AppendLogfmtValue(Writer& inout_writer, const TSTRINGVIEW in_text) noexcept
+{
+    if (!in_text.empty() && (FindSpecialChar<true>(in_text.data(), in_text.size()) == in_text.size()))
+    {
+        inout_writer.Append(in_text);
+        return;
+    }
+    inout_writer.Append(TCHARTYPE('"'));
+    AppendJsonString(inout_writer, in_text);
+    inout_writer.Append(TCHARTYPE('"'));
+}
+
+enum class StructuredFormat
+{
+    Json,   // One object per line: time, level, category, msg, then one member per field.
+    Logfmt, // One line of key=value pairs, in the same order.
+};
+
+class StructuredEncoder final
+{
+public:
+    StructuredEncoder(const StructuredFormat in_format, const Frontend::TBACKENDFUNC& in_backend, const int in_subSecondDigits = 3, const bool in_utc = true) 
+        : m_format(in_format)
+        , m_backend(in_backend)
+        , m_timestampFormatter(in_subSecondDigits, in_utc)
+        , m_utc(in_utc)
+    { ; }
+
+    LogLevelTokens logLevelTokens;
+
+    void operator()(const BinaryRecord& in_record) const noexcept
+    {
+        // Lines are built in buffers owned by the thread, so that their capacity is reused. Nested calls (text
+        // backends that log) use buffers of their own.
+        thread_local Writer t_line, t_message;
+        thread_local bool t_inUse = false;
+        Writer nestedLine, nestedMessage;
+        Writer& line    = t_inUse ? nestedLine    : t_line;
+        Writer& message = t_inUse ? nestedMessage : t_message;
+        const bool wasInUse = std::exchange(t_inUse, true);
+        line.Clear();
+        message.Clear();
+
+        // Operands other than fields (keys and the operand that follows each one) make up the message.
+        bool isFieldValue = false;
+        if (VisitArguments(in_record.arguments, in_record.argumentsSize, [&message, &isFieldValue](const ArgumentTag in_tag, const auto in_value)
+        {
+            if (!std::exchange(isFieldValue, in_tag == ArgumentTag::Key) && (in_tag != ArgumentTag::Key))
+                WriteArgument(message, in_value);
+        }))
+        {
+            const bool isJson = (m_format == StructuredFormat::Json);
+            line.AppendNarrow(isJson ? "{\"time\":\"" : "time=", isJson ? 9 : 5);
+            const size_t timeOffset = line.Size();
+            m_timestampFormatter.AppendTimestamp(line, in_record.timestamp);
+            const_cast<TCHARTYPE*>(line.Data())[timeOffset + 10] = TCHARTYPE('T'); // RFC 3339.
+            if (m_utc)
+                line.Append(TCHARTYPE('Z'));
+            if (isJson)
+                line.Append(TCHARTYPE('"'));
+            AppendMember(line, DSTRING("level"), logLevelTokens.Get(in_record.callSite->logLevel));
+            AppendMember(line, DSTRING("category"), in_record.categoryName ? TSTRINGVIEW(in_record.categoryName) : TSTRINGVIEW());
+            AppendMember(line, DSTRING("msg"), message.View());
+
+            // Fields of the thread context first, then those of the statement.
+            const auto appendFields = [this, &line, isJson](const TCHARTYPE* in_arguments, const size_t in_argumentsSize)
+            {
+                bool isFieldValue = false;
+                VisitArguments(in_arguments, in_argumentsSize, [this, &line, &isFieldValue](const ArgumentTag, const auto in_value)
+                {
+                    if constexpr (std::is_same_v<decltype(in_value), const KeyView>)
+                    {
+                        AppendKey(line, in_value);
+                        isFieldValue = true;
+                    }
+                    else if (std::exchange(isFieldValue, false))
+                        AppendValue(line, in_value);
+                });
+                if (isFieldValue) // The last key had no value.
+                    line.AppendNarrow(isJson ? "null" : "", isJson ? 4 : 0);
+            };
+            if (in_record.context)
+                appendFields(in_record.context->GetArguments().data(), in_record.context->GetArguments().size());
+            appendFields(in_record.arguments, in_record.argumentsSize);
+            if (isJson)
+                line.Append(TCHARTYPE('}'));
+            line.Append(TCHARTYPE('\n'));
+            m_backend(line.CStr(), in_record.categoryName);
+        }
+        t_inUse = wasInUse;
+    }
+
+private:
+    StructuredFormat m_format;
+    Frontend::TBACKENDFUNC m_backend;
+    TimestampFormatter m_timestampFormatter;
+    bool m_utc;
+
+    void AppendMember(Writer& inout_line, const TCHARTYPE* in_key, const TSTRINGVIEW in_value) const noexcept
+    {
+        AppendKey(inout_line, KeyView { in_key, in_key });
+        AppendValue(inout_line, in_value);
+    }
+
+    // Keys come escaped for JSON (see dlog::Key). logfmt keys can't be quoted, so their special characters become '_'.
+    void AppendKey(Writer& inout_line, const KeyView in_key) const noexcept
+    {
+        if (m_format == StructuredFormat::Json)
+        {
+            inout_line.AppendNarrow(",\"", 2);
+            inout_line.Append(in_key.escapedName);
+            inout_line.AppendNarrow("\":", 2);
+            return;
+        }
+        inout_line.Append(TCHARTYPE(' '));
+        for (const TCHARTYPE it : in_key.name)
+            inout_line.Append(IsSpecialChar<true>(it) ? TCHARTYPE('_') : it);
+        inout_line.Append(TCHARTYPE('='));
+    }
+
+    // Numbers and booleans are written as such; anything else as a string.
+    template<typename T>
+    void AppendValue(Writer& inout_line, const T in_value) const noexcept
+    {
+        const bool isJson = (m_format == StructuredFormat::Json);
+        if constexpr (std::is_same_v<T, TCHARTYPE>)
+            AppendValue(inout_line, TSTRINGVIEW(&in_value, 1));
+        else if constexpr (std::is_same_v<T, TSTRINGVIEW>)
+        {
+            if (!isJson)
+                return AppendLogfmtValue(inout_line, in_value);
+            inout_line.Append(TCHARTYPE('"'));
+            AppendJsonString(inout_line, in_value);
+            inout_line.Append(TCHARTYPE('"'));
+        }
+        else if constexpr (std::is_same_v<T, std::nullptr_t>) 
+            inout_line.AppendNarrow("null", 4);
+        else if constexpr (std::is_integral_v<T> || std::is_floating_point_v<T>)
+        {
+            // JSON numbers can't be infinite nor NaN.
+            bool isQuoted = false;
+            if constexpr (std::is_floating_point_v<T>)
+                isQuoted = isJson && !std::isfinite(in_value);
+            if (isQuoted)
+                inout_line.Append(TCHARTYPE('"'));
+            WriteArgument(inout_line, in_value);
+            if (isQuoted)
+                inout_line.Append(TCHARTYPE('"'));
+        }
+        else // Pointers.
+        {
+            if (isJson)
+                inout_line.Append(TCHARTYPE('"'));
+            WriteArgument(inout_line, in_value);
+            if (isJson)
+                inout_line.Append(TCHARTYPE('"'));
+        }
+    }
+};
+}// dlog.
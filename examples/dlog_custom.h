@@ -35,7 +35,9 @@
 struct dlogCharType      { using type = char; };
 struct dlogAllocatorType { using type = std::allocator<dlogCharType::type>; };
 
-template<typename T> void dlogStringifyCustomType(std::stringstream& inout_stream, const std::vector<T>& in_value) noexcept;
-#include "std_vector_value_writer.h"
+namespace dlog { class Writer; }
+template<typename T> void dlogStringifyCustomType(dlog::Writer& inout_writer, const std::vector<T>& in_value) noexcept;
 
 #include "../dlog.h"
+
+#include "std_vector_value_writer.h"
@@ -24,19 +24,21 @@
 
 #pragma once
 
+#include <charconv>
 #include <chrono>
-#include <ctime>
 
-inline std::string ElapsedTimeFormatter(const DLOGLEVELTOSTRFUNC& in_logLevelToStrFunc, const std::string& in_message, const int in_logLevel) noexcept
+// "WRN -      125 ms - Message.": the prefix is appended to the line buffer directly, so nothing is allocated.
+inline void ElapsedTimeFormatter(dlog::Writer& inout_writer, const dlog::LogLevelTokens& in_logLevelTokens, const int in_logLevel, const int64_t) noexcept
 {
-    std::stringstream ss;
-    in_logLevelToStrFunc(ss, in_logLevel);
-    ss << " - ";
+    inout_writer.Append(in_logLevelTokens.Get(in_logLevel));
+    inout_writer << " - ";
 
     static const auto begin = std::chrono::steady_clock::now();
     auto now = std::chrono::steady_clock::now();
-    ss << std::setfill(' ') << std::setw(8) << std::chrono::duration_cast<std::chrono::milliseconds>(now - begin).count();
-    ss << " ms - " << in_message;
-
-    return ss.str();
+    char digits[24];
+    const size_t count = size_t(std::to_chars(digits, digits + sizeof(digits), std::chrono::duration_cast<std::chrono::milliseconds>(now - begin).count()).ptr - digits);
+    for (size_t i = count; i < 8; ++i)
+        inout_writer << ' ';
+    inout_writer.AppendNarrow(digits, count);
+    inout_writer << " ms - ";
 }
@@ -25,25 +25,14 @@
 #pragma once
 
 #include <chrono>
-#include <ctime>
 
-inline std::string SimpleFormatter(const DLOGLEVELTOSTRFUNC& in_logLevelToStrFunc, const std::string& in_message, const int in_logLevel) noexcept
+// "WRN - 2023-01-31 23:59:59 - Message.": the prefix is appended to the line buffer directly, so nothing is allocated.
+inline void SimpleFormatter(dlog::Writer& inout_writer, const dlog::LogLevelTokens& in_logLevelTokens, const int in_logLevel, const int64_t in_timestamp) noexcept
 {
-    std::stringstream ss;
-    in_logLevelToStrFunc(ss, in_logLevel);
-    ss << " - ";
+    static const dlog::TimestampFormatter timestampFormatter(0); // Renders the date and time once per second, not per line.
 
-    std::time_t gt = std::time (nullptr);
-#   pragma warning(push)
-#   pragma warning(disable: 4996) // This function or variable may be unsafe. Consider using localtime_s instead.
-    const auto  lt = std::localtime(&gt);
-#   pragma warning(pop)
-    ss  << std::setfill('0') << std::setw(4) << lt->tm_year + 1900 << '-'
-        << std::setfill('0') << std::setw(2) << lt->tm_mon  + 1    << '-'
-        << std::setfill('0') << std::setw(2) << lt->tm_mday        << ' '
-        << std::setfill('0') << std::setw(2) << lt->tm_hour        << ':' 
-        << std::setfill('0') << std::setw(2) << lt->tm_min         << ':' 
-        << std::setfill('0') << std::setw(2) << lt->tm_sec         << ' '
-        << "- " << in_message;
-    return ss.str();
+    inout_writer.Append(in_logLevelTokens.Get(in_logLevel));
+    inout_writer << " - ";
+    timestampFormatter.AppendTimestamp(inout_writer, in_timestamp);
+    inout_writer << " - ";
 }
@@ -24,17 +24,17 @@
 
 #pragma once
 
-#include <sstream>
+#include <vector>
 
 template<typename T>
-void dlogStringifyCustomType(std::stringstream& inout_stream, const std::vector<T>& in_value) noexcept
+void dlogStringifyCustomType(dlog::Writer& inout_writer, const std::vector<T>& in_value) noexcept
 {
-    inout_stream << '[';
+    inout_writer << '[';
     for (size_t i = 0, l = in_value.size(); i < l;)
     {
-        ::dlogStringifyBuiltInType(inout_stream, in_value.at(i));
+        ::dlogStringifyBuiltInType(inout_writer, in_value.at(i));
         if ((++i) != l)
-            inout_stream << ',';
+            inout_writer << ',';
     }
-    inout_stream << ']';
+    inout_writer << ']';
 }
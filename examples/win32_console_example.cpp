@@ -26,6 +26,7 @@
 #include "elapsed_time_formatter.h"
 #include "simple_formatter.h"
 
+#include <cfloat>
 #include <climits>
 #include <cstdio>
 #include <mutex>
@@ -48,7 +49,7 @@ int main(int, char**)
         std::scoped_lock<std::mutex> backendLock(defaultBackendMutex);
         printf("[%s] %s", in_categoryName, in_message); 
     };
-    logger.formatter = SimpleFormatter;
+    logger.prefixFormatter = SimpleFormatter;
 
     DLOG(DWARNING) << "bool..............: " << (bool              )false     << ", " << (bool              )true       << ".";
     DLOG(DWARNING) << "char..............: " << (char              )'A'       << ", " << (char              )'Z'        << ".";
@@ -72,6 +73,7 @@ int main(int, char**)
 
     const std::vector<int> somePrimes  = { 2, 3, 5, 7, 11 };
     DLOG(DWARNING) << "Custom type.......: " << somePrimes << ".";
+    DLOGF(DWARNING, "Format string.....: x={} y={:x} z={:.3} primes={}.", 42, 0xC0FFEEu, 3.14159265, somePrimes);
     DLOG(DINFO   ) << "This message will not be displayed.";
     DLOG(DWARNING, "Foo") << "Logging message to custom category \"Foo\".";
     DLOG(DERROR  ) << "Error-level message.";
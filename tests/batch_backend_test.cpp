@@ -0,0 +1,87 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2023 David Caadas Mazo.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE.
+ */
+
+// Batch backends that log, flush or are flushed from their own delivery must not deadlock: every message, nested
+// ones included, has to reach the backend. Run by ctest, which times it out if it hangs.
+//
+// Usage: batch_backend_test
+
+#include "../dlog.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+namespace
+{
+// Logs "outer" messages, and a "nested" message from the backend for each of them.
+bool Run(const char* in_name, const bool in_async, const bool in_flushFromBackend)
+{
+    std::mutex mutex;
+    size_t outer = 0, nested = 0;
+    {
+        DLog logger;
+        logger += DLog::BatchBackend
+        {
+            [&](const dlog::Record* in_records, const size_t in_count)
+            {
+                for (size_t i = 0; i < in_count; ++i)
+                {
+                    const bool isNested = in_records[i].message.find(DSTRING("nested")) != dlog::TSTRINGVIEW::npos;
+                    {
+                        std::scoped_lock<std::mutex> lock(mutex);
+                        ++(isNested ? nested : outer);
+                    }
+                    if (!isNested)
+                        DLOG(DINFO) << "nested " << i;
+                }
+                if (in_flushFromBackend)
+                    logger.Flush();
+            },
+            { 1, 64 * 1024, std::chrono::milliseconds(100) }
+        };
+        if (in_async)
+            logger.EnableAsync();
+
+        for (int i = 0; i < 100; ++i)
+            DLOG(DINFO) << "outer " << i;
+        logger.Flush();
+        logger.Flush(); // Delivers the messages logged by the last delivery.
+    }
+
+    const bool succeeded = (outer == 100) && (nested == 100);
+    printf("%-24s outer: %3zu, nested: %3zu %s\n", in_name, outer, nested, succeeded ? "ok" : "FAILED");
+    return succeeded;
+}
+}
+
+int main()
+{
+    bool succeeded = true;
+    succeeded &= Run("synchronous", false, false);
+    succeeded &= Run("synchronous, flushing", false, true);
+    succeeded &= Run("asynchronous", true, false);
+    succeeded &= Run("asynchronous, flushing", true, true);
+    return succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
+}
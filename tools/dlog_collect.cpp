@@ -0,0 +1,193 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2023 David Caadas Mazo.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE.
+ */
+
+// Collects the messages that processes send through the shared-memory transport (see dlog_shared_memory.h) and
+// writes them, ordered by timestamp, to the standard output or to a file. Runs until interrupted.
+// Usage: dlog_collect [--name=dlog] [--rings=N] [--slots=N] [--slot-size=N] [--output=file] [--reorder-window=ms] [--remove]
+//   --name     : name of the segment (default: dlog).
+//   --rings, --slots, --slot-size: geometry of the segment, if the collector is the one creating it.
+//   --output   : file to append the messages to (default: standard output).
+//   --reorder-window: time messages are held, so that those polled later still come out in order (default: 100).
+//                Messages that arrive even later, or when more than 65536 are held, are written out of order.
+//   --remove   : removes the segment name on exit.
+
+#include "../dlog_shared_memory.h"
+
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <map>
+
+namespace
+{
+std::atomic<bool> s_stop { false };
+constexpr size_t k_maxHeldRecords = 65536;
+
+void OnSignal(int) { s_stop = true; }
+
+const char* LogLevelToken(const int in_logLevel) noexcept
+{
+    switch (in_logLevel)
+    {
+    case DINFO    : return "INF";
+    case DWARNING : return "WRN";
+    case DERROR   : return "ERR";
+    case DDFATAL  : return "DBG";
+    case DFATAL   : return "FTL";
+    }
+    return "???";
+}
+
+// Lines are built as TCHARTYPE text and written by a single function: a stream written with both byte and wide
+// functions has undefined behavior.
+void PrintRecord(FILE* inout_output, const dlog::SharedMemoryCollector::Record& in_record) noexcept
+{
+    static dlog::Writer s_line;
+    s_line.Clear();
+    if (in_record.isFormatted)
+    {
+        s_line.Append(dlog::TSTRINGVIEW(in_record.message));
+        if (in_record.isTruncated)
+            s_line.AppendNarrow("...\n", 4);
+    }
+    else
+    {
+        const std::time_t seconds = std::time_t(in_record.timestamp / 1000000000);
+        const int milliseconds = int((in_record.timestamp / 1000000) % 1000);
+        char time[48] = "";
+        size_t length = 0;
+#   pragma warning(push)
+#   pragma warning(disable: 4996) // This function or variable may be unsafe. Consider using gmtime_s instead.
+        if (const std::tm* utc = std::gmtime(&seconds))
+            length = std::strftime(time, sizeof(time), "%Y-%m-%d %H:%M:%S", utc);
+#   pragma warning(pop)
+        length += size_t(snprintf(time + length, sizeof(time) - length, ".%03d ", milliseconds));
+
+        const char* logLevelToken = LogLevelToken(in_record.logLevel);
+        s_line.AppendNarrow(time, length);
+        dlog::WriteInteger(s_line, in_record.processId);
+        s_line.AppendNarrow(" [", 2);
+        s_line.Append(dlog::TSTRINGVIEW(in_record.categoryName));
+        s_line.AppendNarrow("] ", 2);
+        s_line.AppendNarrow(logLevelToken, strlen(logLevelToken));
+        s_line.Append(dlog::TCHARTYPE(' '));
+        s_line.AppendNarrow(in_record.fileName.data(), in_record.fileName.size());
+        s_line.Append(dlog::TCHARTYPE(':'));
+        dlog::WriteInteger(s_line, in_record.line);
+        s_line.AppendNarrow(" - ", 3);
+        s_line.Append(dlog::TSTRINGVIEW(in_record.message));
+        if (in_record.isTruncated)
+            s_line.AppendNarrow("...", 3);
+        s_line.Append(dlog::TCHARTYPE('\n'));
+    }
+
+    if constexpr (std::is_same_v<dlog::TCHARTYPE, char>)
+        fputs((const char*)s_line.CStr(), inout_output);
+    else
+        fputws((const wchar_t*)s_line.CStr(), inout_output);
+}
+
+const char* GetOption(const char* in_argument, const char* in_name) noexcept
+{
+    const size_t length = strlen(in_name);
+    return ((strncmp(in_argument, in_name, length) == 0) && (in_argument[length] == '=')) ? (in_argument + length + 1) : nullptr;
+}
+}
+
+int main(int in_argc, char** in_argv)
+{
+    dlog::SharedMemoryOptions options;
+    const char* outputName = nullptr;
+    int64_t reorderWindow = 100000000; // Nanoseconds.
+    bool remove = false;
+    for (int i = 1; i < in_argc; ++i)
+    {
+        if      (const char* value = GetOption(in_argv[i], "--name"     )) options.name = value;
+        else if (const char* value = GetOption(in_argv[i], "--rings"    )) options.ringCount = uint32_t(strtoul(value, nullptr, 10));
+        else if (const char* value = GetOption(in_argv[i], "--slots"    )) options.slotCount = uint32_t(strtoul(value, nullptr, 10));
+        else if (const char* value = GetOption(in_argv[i], "--slot-size")) options.slotSize  = uint32_t(strtoul(value, nullptr, 10));
+        else if (const char* value = GetOption(in_argv[i], "--output"   )) outputName = value;
+        else if (const char* value = GetOption(in_argv[i], "--reorder-window")) reorderWindow = int64_t(strtoul(value, nullptr, 10)) * 1000000;
+        else if (strcmp(in_argv[i], "--remove") == 0) remove = true;
+        else
+        {
+            fprintf(stderr, "Usage: %s [--name=dlog] [--rings=N] [--slots=N] [--slot-size=N] [--output=file] [--reorder-window=ms] [--remove]\n", in_argv[0]);
+            fprintf(stderr, "Messages are held for the reorder window (100 ms by default) to be written in timestamp order; those that\n"
+                            "arrive later, or when more than %zu are held, are written out of order.\n", k_maxHeldRecords);
+            return EXIT_FAILURE;
+        }
+    }
+
+#   pragma warning(push)
+#   pragma warning(disable: 4996) // This function or variable may be unsafe. Consider using fopen_s instead.
+    FILE* output = outputName ? fopen(outputName, "ab") : stdout;
+#   pragma warning(pop)
+    if (!output)
+    {
+        fprintf(stderr, "%s: cannot open file.\n", outputName);
+        return EXIT_FAILURE;
+    }
+
+    std::signal(SIGINT , OnSignal);
+    std::signal(SIGTERM, OnSignal);
+    try
+    {
+        // Each poll is sorted by the collector, but processes may publish a message after a more recent one of
+        // another process was polled: messages are held for the reorder window and merged across polls.
+        dlog::SharedMemoryCollector collector(options);
+        std::multimap<int64_t, dlog::SharedMemoryCollector::Record> held;
+        const auto hold = [&held](const dlog::SharedMemoryCollector::Record& in_record) { held.emplace(in_record.timestamp, in_record); };
+        const auto release = [&held, output](const int64_t in_before)
+        {
+            for (auto it = held.begin(); (it != held.end()) && ((it->first < in_before) || (held.size() > k_maxHeldRecords)); it = held.erase(it))
+                PrintRecord(output, it->second);
+        };
+        while (!s_stop)
+        {
+            const size_t count = collector.Poll(hold);
+            release(dlog::Now() - reorderWindow);
+            if (count == 0)
+            {
+                fflush(output);
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        }
+        while (collector.Poll(hold) != 0)
+            ;
+        release(std::numeric_limits<int64_t>::max());
+        fprintf(stderr, "%llu message(s) dropped, %llu lost.\n", (unsigned long long)collector.GetDroppedCount(), (unsigned long long)collector.GetLostCount());
+    }
+    catch (const dlog::Exception&)
+    {
+        fprintf(stderr, "%s: cannot open or create the shared memory segment.\n", options.name.c_str());
+        return EXIT_FAILURE;
+    }
+
+    if (output != stdout)
+        fclose(output);
+    if (remove)
+        dlog::SharedMemorySegment::Remove(options.name);
+    return EXIT_SUCCESS;
+}
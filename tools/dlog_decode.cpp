@@ -0,0 +1,98 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2023 David Caadas Mazo.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE.
+ */
+
+// Converts binary log files (see dlog_binary.h) to text.
+// Usage: dlog_decode <file> [<file>...]
+
+#include "../dlog_binary.h"
+
+#include <cstdio>
+#include <ctime>
+
+namespace
+{
+const char* LogLevelToken(const int in_logLevel) noexcept
+{
+    switch (in_logLevel)
+    {
+    case DINFO    : return "INF";
+    case DWARNING : return "WRN";
+    case DERROR   : return "ERR";
+    case DDFATAL  : return "DBG";
+    case DFATAL   : return "FTL";
+    }
+    return "???";
+}
+
+void PrintRecord(const dlog::BinaryFileReader::Record& in_record) noexcept
+{
+    const std::time_t seconds = std::time_t(in_record.timestamp / 1000000000);
+    const int milliseconds = int((in_record.timestamp / 1000000) % 1000);
+    char time[32] = "";
+#   pragma warning(push)
+#   pragma warning(disable: 4996) // This function or variable may be unsafe. Consider using gmtime_s instead.
+    if (const std::tm* utc = std::gmtime(&seconds))
+        std::strftime(time, sizeof(time), "%Y-%m-%d %H:%M:%S", utc);
+#   pragma warning(pop)
+
+    const dlog::TSTRING category(in_record.categoryName);
+    const dlog::TSTRING message (in_record.message.View());
+    if constexpr (std::is_same_v<dlog::TCHARTYPE, char>)
+        printf("%s.%03d [%s] %s %s:%d - %s\n", time, milliseconds, (const char*)category.c_str(), LogLevelToken(in_record.callSite->logLevel), in_record.callSite->fileName, in_record.callSite->line, (const char*)message.c_str());
+    else
+        printf("%s.%03d [%ls] %s %s:%d - %ls\n", time, milliseconds, (const wchar_t*)category.c_str(), LogLevelToken(in_record.callSite->logLevel), in_record.callSite->fileName, in_record.callSite->line, (const wchar_t*)message.c_str());
+}
+}
+
+int main(int in_argc, char** in_argv)
+{
+    if (in_argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <file> [<file>...]\n", in_argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    int result = EXIT_SUCCESS;
+    for (int i = 1; i < in_argc; ++i)
+    {
+        try
+        {
+            dlog::BinaryFileReader reader(in_argv[i]);
+            dlog::BinaryFileReader::Record record;
+            while (reader.ReadNext(record))
+                PrintRecord(record);
+            if (reader.IsCorrupted())
+            {
+                fprintf(stderr, "%s: truncated or corrupted file.\n", in_argv[i]);
+                result = EXIT_FAILURE;
+            }
+        }
+        catch (const dlog::Exception&)
+        {
+            fprintf(stderr, "%s: cannot open file or not a dlog binary file.\n", in_argv[i]);
+            result = EXIT_FAILURE;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,153 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2023 David Caadas Mazo.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE.
+ */
+
+// Prints the messages of block-compressed log files (see dlog_block_file.h) that match a query, reading only the
+// blocks whose headers show that they may contain some.
+// Usage: dlog_query [--from=time] [--to=time] [--level=level] [--category=name...] [--text=text] [--stats] <file> [<file>...]
+//   --from, --to : inclusive time range, as nanoseconds since the epoch or as UTC YYYY-MM-DD[THH:MM[:SS]].
+//   --level      : lowest level to print, as a number or as INF, WRN, ERR, DBG or FTL.
+//   --category   : category to print (may be repeated; all categories by default).
+//   --text       : text that messages must contain.
+//   --stats      : prints the blocks read and skipped, and the compression ratio, to the standard error.
+
+#include "../dlog_block_file.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+// Days since 1970-01-01 of a proleptic Gregorian date (timegm is not portable).
+int64_t DaysFromCivil(int64_t in_year, const int64_t in_month, const int64_t in_day) noexcept
+{
+    in_year -= (in_month <= 2) ? 1 : 0;
+    const int64_t era = ((in_year >= 0) ? in_year : (in_year - 399)) / 400;
+    const int64_t yearOfEra = in_year - (era * 400);
+    const int64_t dayOfYear = (((153 * (in_month + ((in_month > 2) ? -3 : 9))) + 2) / 5) + in_day - 1;
+    const int64_t dayOfEra = (yearOfEra * 365) + (yearOfEra / 4) - (yearOfEra / 100) + dayOfYear;
+    return (era * 146097) + dayOfEra - 719468;
+}
+
+bool ParseTime(const char* in_text, int64_t& out_timestamp) noexcept
+{
+    int year = 0, month = 0, day = 0, hours = 0, minutes = 0, seconds = 0;
+    const int fields = sscanf(in_text, "%d-%d-%dT%d:%d:%d", &year, &month, &day, &hours, &minutes, &seconds);
+    if ((fields == 3) || (fields >= 5))
+    {
+        out_timestamp = ((((DaysFromCivil(year, month, day) * 24 + hours) * 60 + minutes) * 60) + seconds) * 1000000000;
+        return true;
+    }
+    char* end = nullptr;
+    out_timestamp = strtoll(in_text, &end, 10);
+    return (end != in_text) && (*end == 0);
+}
+
+bool ParseLogLevel(const char* in_text, int& out_logLevel) noexcept
+{
+    static constexpr struct { const char* token; int logLevel; } k_levels[] =
+    {
+        { "INF", DINFO }, { "WRN", DWARNING }, { "ERR", DERROR }, { "DBG", DDFATAL }, { "FTL", DFATAL },
+    };
+    for (const auto& it : k_levels)
+    {
+        if (strcmp(in_text, it.token) == 0)
+        {
+            out_logLevel = it.logLevel;
+            return true;
+        }
+    }
+    char* end = nullptr;
+    out_logLevel = int(strtol(in_text, &end, 10));
+    return (end != in_text) && (*end == 0);
+}
+
+// Arguments are expected to be ASCII when logging wide characters.
+dlog::TSTRING ToText(const char* in_text) { return dlog::TSTRING(in_text, in_text + strlen(in_text)); }
+
+const char* GetOption(const char* in_argument, const char* in_name) noexcept
+{
+    const size_t length = strlen(in_name);
+    return ((strncmp(in_argument, in_name, length) == 0) && (in_argument[length] == '=')) ? (in_argument + length + 1) : nullptr;
+}
+}
+
+int main(int in_argc, char** in_argv)
+{
+    dlog::BlockQuery query;
+    bool statistics = false;
+    bool valid = true;
+    std::vector<const char*> fileNames;
+    for (int i = 1; (i < in_argc) && valid; ++i)
+    {
+        if      (const char* value = GetOption(in_argv[i], "--from"    )) valid = ParseTime(value, query.fromTimestamp);
+        else if (const char* value = GetOption(in_argv[i], "--to"      )) valid = ParseTime(value, query.toTimestamp);
+        else if (const char* value = GetOption(in_argv[i], "--level"   )) valid = ParseLogLevel(value, query.minLogLevel);
+        else if (const char* value = GetOption(in_argv[i], "--category")) query.categories.push_back(ToText(value));
+        else if (const char* value = GetOption(in_argv[i], "--text"    )) query.text = ToText(value);
+        else if (strcmp(in_argv[i], "--stats") == 0) statistics = true;
+        else if (strncmp(in_argv[i], "--", 2) != 0) fileNames.push_back(in_argv[i]);
+        else valid = false;
+    }
+    if (!valid || fileNames.empty())
+    {
+        fprintf(stderr, "Usage: %s [--from=time] [--to=time] [--level=level] [--category=name...] [--text=text] [--stats] <file> [<file>...]\n", in_argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    int result = EXIT_SUCCESS;
+    for (const char* fileName : fileNames)
+    {
+        try
+        {
+            dlog::BlockFileReader reader(fileName, query);
+            dlog::BlockFileReader::Record record;
+            while (reader.ReadNext(record))
+            {
+                if constexpr (std::is_same_v<dlog::TCHARTYPE, char>)
+                    fwrite(record.message.data(), 1, record.message.size(), stdout);
+                else
+                    fprintf(stdout, "%.*ls", int(record.message.size()), (const wchar_t*)record.message.data());
+            }
+            if (reader.IsCorrupted())
+            {
+                fprintf(stderr, "%s: corrupted file.\n", fileName);
+                result = EXIT_FAILURE;
+            }
+            if (statistics)
+            {
+                const dlog::BlockFileReader::Statistics& stats = reader.GetStatistics();
+                fprintf(stderr, "%s: %llu block(s), %llu skipped, %llu of %llu record(s) matched, %llu -> %llu bytes (%.2fx).\n", fileName,
+                        (unsigned long long)stats.blocks, (unsigned long long)stats.skippedBlocks, (unsigned long long)stats.matchedRecords, (unsigned long long)stats.records,
+                        (unsigned long long)stats.compressedBytes, (unsigned long long)stats.uncompressedBytes,
+                        stats.compressedBytes ? (double(stats.uncompressedBytes) / double(stats.compressedBytes)) : 0.0);
+            }
+        }
+        catch (const dlog::Exception&)
+        {
+            fprintf(stderr, "%s: cannot open file, or not a block-compressed log file.\n", fileName);
+            result = EXIT_FAILURE;
+        }
+    }
+    return result;
+}